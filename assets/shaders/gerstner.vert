@@ -0,0 +1,82 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec3 aColor;
+
+uniform mat4 u_model;
+uniform float u_time;
+uniform float u_amplitude = 1.0;
+
+layout (std140, binding = 0) uniform commom_matrices
+{
+    mat4 u_projection;
+    mat4 u_view;
+};
+
+// must match TrainView::MAX_WAVES and the layout written by TrainView::uploadWaves
+#define MAX_WAVES 64
+
+struct GerstnerWave
+{
+    vec4 dirWavelengthAmp;  // direction.xy, wavelength, amplitude
+    vec4 speedSteepFreq;    // speed, steepness, frequency, unused
+};
+
+layout (std140, binding = 1) uniform wave_params
+{
+    ivec4 u_waveCount;
+    GerstnerWave u_waves[MAX_WAVES];
+};
+
+out V_OUT
+{
+    vec3 worldPos;
+    vec3 worldNormal;
+    vec2 texCoord;
+    float waveHeight;
+} v_out;
+
+void main()
+{
+    vec2 posXZ = aPos.xz;
+    vec3 displaced = aPos;
+    vec3 normal = vec3(0.0, 1.0, 0.0);
+
+    int count = min(u_waveCount.x, MAX_WAVES);
+    float steepnessScale = 1.0 / float(max(count, 1));
+
+    // sum the waves and their analytic partial derivatives (GPU Gems 1, ch. 1)
+    for (int i = 0; i < count; ++i) {
+        vec2 D = normalize(u_waves[i].dirWavelengthAmp.xy);
+        float A = u_waves[i].dirWavelengthAmp.w * u_amplitude;
+        float w = u_waves[i].speedSteepFreq.z;
+        float phi = u_waves[i].speedSteepFreq.x * w;
+        float Q = (w * A > 0.0) ? u_waves[i].speedSteepFreq.y * steepnessScale / (w * A) : 0.0;
+
+        float phase = w * dot(D, posXZ) + phi * u_time;
+        float S = sin(phase);
+        float C = cos(phase);
+
+        displaced.x += Q * A * D.x * C;
+        displaced.z += Q * A * D.y * C;
+        displaced.y += A * S;
+
+        float WA = w * A;
+        normal.x -= D.x * WA * C;
+        normal.z -= D.y * WA * C;
+        normal.y -= Q * WA * S;
+    }
+
+    vec4 worldPosition = u_model * vec4(displaced, 1.0);
+    mat3 normalMatrix = transpose(inverse(mat3(u_model)));
+    vec3 worldNormal = normalize(normalMatrix * normalize(normal));
+
+    gl_Position = u_projection * u_view * worldPosition;
+
+    v_out.worldPos = worldPosition.xyz;
+    v_out.worldNormal = worldNormal;
+    v_out.texCoord = aTexCoord;
+    v_out.waveHeight = (displaced.y - aPos.y) * 4.0;
+}
@@ -0,0 +1,38 @@
+#version 430 core
+// the control point gizmo, one instance per point - drawn with mesh.frag
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 3) in vec4 i_position;      // xyz, w = 1 if selected
+layout (location = 4) in vec4 i_rotation;      // a quaternion, xyzw
+
+uniform mat4 u_model;     // the shadow squash, or nothing
+
+layout (std140, binding = 0) uniform commom_matrices
+{
+    mat4 u_projection;
+    mat4 u_view;
+};
+
+out V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec4 color;
+} v_out;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0f * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    vec4 world = u_model * vec4(i_position.xyz + rotate(i_rotation, position), 1.0f);
+    gl_Position = u_projection * u_view * world;
+
+    v_out.position = vec3(world);
+    v_out.normal = rotate(i_rotation, normal);
+    // selected points are yellow, the rest red
+    v_out.color = (i_position.w > 0.5f) ? vec4(0.94f, 0.94f, 0.12f, 1.0f)
+                                        : vec4(0.94f, 0.24f, 0.24f, 1.0f);
+}
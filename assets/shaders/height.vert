@@ -15,6 +15,8 @@ uniform float u_amp = 0.5;
 uniform float u_speed = 1;
 uniform vec2 u_texel;
 uniform float u_height_mult = 0.7;
+// horizontal displacement from the .gb channels (OceanFFT), 0 = off
+uniform float u_choppy = 0.0;
 
 out vec3 vs_worldpos;
 out vec3 vs_normal;
@@ -48,6 +50,10 @@ void main()
 	float sineWave = sin(sinePhase) * 0.2;
 	float finalHeight = centeredHeight * u_amp + sineWave * 0.3;
 	worldPos.y += finalHeight;
+	if (u_choppy != 0.0) {
+		vec2 choppy = texture(u_heightmap, wrapUV(uv)).gb * u_choppy;
+		worldPos.xz += (u_model * vec4(choppy.x, 0.0, choppy.y, 0.0)).xz;
+	}
 
 	float texelX = max(u_texel.x, 1e-4);
 	float texelY = max(u_texel.y, 1e-4);
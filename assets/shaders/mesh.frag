@@ -0,0 +1,58 @@
+#version 430 core
+out vec4 f_color;
+
+in V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec4 color;
+} f_in;
+
+// the material
+uniform vec4 u_color;
+uniform int u_lit;
+uniform float u_specular;
+uniform float u_shininess;
+
+// the lights, in world space - the same ones the fixed-function path sets up
+const int MAX_LIGHTS = 4;
+uniform int u_light_count;
+uniform vec4 u_light_position[MAX_LIGHTS];     // w = 0 for a directional light
+uniform vec3 u_light_ambient[MAX_LIGHTS];
+uniform vec3 u_light_diffuse[MAX_LIGHTS];
+uniform vec4 u_light_spot[MAX_LIGHTS];         // direction, cos(cutoff) - or -1 for no spot
+uniform float u_light_exponent[MAX_LIGHTS];
+uniform vec3 u_ambient;                        // the light model's global ambient
+uniform vec3 u_camera;
+
+void main()
+{
+    vec4 base = u_color * f_in.color;
+    if (u_lit == 0) {
+        f_color = base;
+        return;
+    }
+
+    vec3 n = normalize(f_in.normal);
+    vec3 v = normalize(u_camera - f_in.position);
+    vec3 result = u_ambient * base.rgb;
+    for (int i = 0; i < u_light_count; ++i) {
+        vec3 l = (u_light_position[i].w == 0.0f)
+            ? normalize(u_light_position[i].xyz)
+            : normalize(u_light_position[i].xyz - f_in.position);
+
+        float spot = 1.0f;
+        if (u_light_spot[i].w > -1.0f) {
+            float c = dot(-l, normalize(u_light_spot[i].xyz));
+            spot = (c < u_light_spot[i].w) ? 0.0f : pow(c, u_light_exponent[i]);
+        }
+
+        float diffuse = max(dot(n, l), 0.0f);
+        result += spot * (u_light_ambient[i] + diffuse * u_light_diffuse[i]) * base.rgb;
+        if (u_specular > 0.0f && diffuse > 0.0f) {
+            vec3 h = normalize(l + v);
+            result += spot * u_specular * pow(max(dot(n, h), 0.0f), u_shininess) * u_light_diffuse[i];
+        }
+    }
+    f_color = vec4(result, base.a);
+}
@@ -0,0 +1,30 @@
+#version 430 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec4 color;
+
+uniform mat4 u_model;
+uniform mat3 u_normal_matrix;
+
+layout (std140, binding = 0) uniform commom_matrices
+{
+    mat4 u_projection;
+    mat4 u_view;
+};
+
+out V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec4 color;
+} v_out;
+
+void main()
+{
+    vec4 world = u_model * vec4(position, 1.0f);
+    gl_Position = u_projection * u_view * world;
+
+    v_out.position = vec3(world);
+    v_out.normal = u_normal_matrix * normal;
+    v_out.color = color;
+}
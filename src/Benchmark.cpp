@@ -0,0 +1,343 @@
+/************************************************************************
+     File:        Benchmark.cpp
+
+     Comment:     Scripted benchmark runs. See Benchmark.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "Benchmark.H"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#pragma warning(push)
+#pragma warning(disable:4312)
+#pragma warning(disable:4311)
+#include <Fl/Fl.H>
+#include <Fl/Fl_Browser.H>
+#include <Fl/Fl_Button.H>
+#include <Fl/Fl_Value_Slider.H>
+#pragma warning(pop)
+
+#include "Json.H"
+#include "TrainView.H"
+#include "TrainWindow.H"
+#include "Utilities/MappedFile.H"
+
+namespace {
+	// what an event may set
+	const char* const EVENT_KEYS[] = {
+		"frame", "camera", "spline", "rail", "shader", "lights",
+		"speed", "cabFov", "arcLength", "run", "move"
+	};
+
+	struct Scene {
+		JsonValue						root;
+		int								frames = 600;
+		double							fps = 60.0;
+		int								warmup = 0;
+		bool							core = false;
+		std::string						track;
+		std::string						output;
+		std::vector<const JsonValue*>	cameraPath;		// by frame
+		std::vector<const JsonValue*>	events;			// by frame
+	};
+
+	int frameOf(const JsonValue* entry)
+	{
+		return static_cast<int>(entry->find("frame")->number());
+	}
+
+	//************************************************************************
+	//
+	// * Read and check the whole scene up front, so a typo fails the run
+	//   before anything is timed
+	//========================================================================
+	bool loadScene(const char* filename, Scene& scene, std::string& error)
+	{
+		MappedFile file;
+		if (!file.open(filename)) {
+			error = "can't read the file";
+			return false;
+		}
+		if (!parseJson(file.data(), file.size(), scene.root, error))
+			return false;
+		const JsonValue& root = scene.root;
+		if (!root.isObject()) {
+			error = "the scene is not an object";
+			return false;
+		}
+
+		if (const JsonValue* v = root.find("frames"))
+			scene.frames = static_cast<int>(v->number(scene.frames));
+		if (const JsonValue* v = root.find("fps"))
+			scene.fps = v->number(scene.fps);
+		if (const JsonValue* v = root.find("warmup"))
+			scene.warmup = static_cast<int>(v->number(scene.warmup));
+		if (const JsonValue* v = root.find("backend"))
+			scene.core = v->string() == "core";
+		if (const JsonValue* v = root.find("track"))
+			scene.track = v->string();
+		if (const JsonValue* v = root.find("output"))
+			scene.output = v->string();
+		if (scene.frames <= 0 || scene.fps <= 0.0 || scene.warmup < 0 || scene.warmup >= scene.frames) {
+			error = "frames, fps or warmup out of range";
+			return false;
+		}
+
+		if (const JsonValue* path = root.find("cameraPath")) {
+			for (size_t i = 0; i < path->size(); ++i) {
+				const JsonValue& key = (*path)[i];
+				for (const char* name : { "frame", "yaw", "pitch", "distance" })
+					if (!key.isObject() || !key.find(name) || !key.find(name)->isNumber()) {
+						error = "cameraPath entry " + std::to_string(i) + " needs frame, yaw, pitch and distance";
+						return false;
+					}
+				scene.cameraPath.push_back(&key);
+			}
+		}
+
+		if (const JsonValue* events = root.find("events")) {
+			for (size_t i = 0; i < events->size(); ++i) {
+				const JsonValue& event = (*events)[i];
+				if (!event.isObject() || !event.find("frame") || !event.find("frame")->isNumber()) {
+					error = "event " + std::to_string(i) + " has no frame";
+					return false;
+				}
+				for (size_t k = 0; k < event.size(); ++k) {
+					const JsonValue& value = event[k];
+					bool known = false;
+					for (const char* name : EVENT_KEYS)
+						known = known || event.find(name) == &value;
+					if (!known) {
+						error = "event " + std::to_string(i) + " sets something unknown";
+						return false;
+					}
+				}
+				if (const JsonValue* move = event.find("move")) {
+					const JsonValue* point = move->find("point");
+					const JsonValue* by = move->find("by");
+					if (!point || !point->isNumber() || !by || by->size() != 3) {
+						error = "event " + std::to_string(i) + ": move needs a point and by [x, y, z]";
+						return false;
+					}
+				}
+				scene.events.push_back(&event);
+			}
+		}
+
+		auto byFrame = [](const JsonValue* a, const JsonValue* b) { return frameOf(a) < frameOf(b); };
+		std::stable_sort(scene.cameraPath.begin(), scene.cameraPath.end(), byFrame);
+		std::stable_sort(scene.events.begin(), scene.events.end(), byFrame);
+		return true;
+	}
+
+	//************************************************************************
+	//
+	// * Returns true if the track was edited. "run" is the Run button, so
+	//   the packets and the simulation see it the way they always do
+	//========================================================================
+	bool applyEvent(TrainWindow& tw, const JsonValue& event)
+	{
+		if (const JsonValue* v = event.find("camera")) {
+			tw.worldCam->value(v->string() == "world");
+			tw.trainCam->value(v->string() == "train");
+			tw.topCam->value(v->string() == "top");
+		}
+		if (const JsonValue* v = event.find("spline"))
+			tw.splineBrowser->value(static_cast<int>(v->number()));
+		if (const JsonValue* v = event.find("rail"))
+			tw.railBrowser->value(static_cast<int>(v->number()));
+		if (const JsonValue* v = event.find("shader"))
+			tw.shaderBrowser->value(static_cast<int>(v->number()));
+		if (const JsonValue* v = event.find("lights"))
+			tw.lightBrowser->value(static_cast<int>(v->number()));
+		if (const JsonValue* v = event.find("speed"))
+			tw.speed->value(v->number());
+		if (const JsonValue* v = event.find("cabFov"))
+			tw.cabFov->value(v->number());
+		if (const JsonValue* v = event.find("arcLength"))
+			tw.arcLength->value(v->boolean());
+		if (const JsonValue* v = event.find("run"))
+			tw.runButton->value(v->boolean());
+
+		const JsonValue* move = event.find("move");
+		if (!move)
+			return false;
+		const size_t point = static_cast<size_t>(move->find("point")->number());
+		if (point >= tw.m_Track.points.size())
+			return false;
+		const JsonValue& by = *move->find("by");
+		Pnt3fRef pos = tw.m_Track.points[point].pos;
+		pos.x += static_cast<float>(by[0].number());
+		pos.y += static_cast<float>(by[1].number());
+		pos.z += static_cast<float>(by[2].number());
+		tw.m_Track.markChanged();
+		return true;
+	}
+
+	//************************************************************************
+	//
+	// * The world camera on the path - straight lines between keyframes
+	//========================================================================
+	void followPath(TrainView& view, const std::vector<const JsonValue*>& path, int frame)
+	{
+		if (path.empty())
+			return;
+		size_t next = 0;
+		while (next < path.size() && frameOf(path[next]) <= frame)
+			++next;
+		const JsonValue& a = *path[next > 0 ? next - 1 : 0];
+		const JsonValue& b = *path[next < path.size() ? next : path.size() - 1];
+		const int span = frameOf(&b) - frameOf(&a);
+		const float t = span > 0 ? static_cast<float>(frame - frameOf(&a)) / span : 0.0f;
+		auto along = [&](const char* name) {
+			const float from = static_cast<float>(a.find(name)->number());
+			const float to = static_cast<float>(b.find(name)->number());
+			return from + (to - from) * t;
+		};
+
+		const float halfYaw = along("yaw") * 3.14159265f / 360.0f;
+		const float halfPitch = along("pitch") * 3.14159265f / 360.0f;
+		const Quat yaw(0.0f, std::sin(halfYaw), 0.0f, std::cos(halfYaw));
+		const Quat pitch(std::sin(halfPitch), 0.0f, 0.0f, std::cos(halfPitch));
+		view.arcball.setView(pitch * yaw, along("distance"));
+	}
+
+	// for the JSON line - Windows paths are full of backslashes
+	std::string escaped(const char* text)
+	{
+		std::string out;
+		for (const char* c = text; *c; ++c) {
+			if (*c == '\\' || *c == '"')
+				out += '\\';
+			out += *c;
+		}
+		return out;
+	}
+
+	// nearest rank
+	double percentile(const std::vector<double>& sorted, double p)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+		return sorted[rank > 0 ? rank - 1 : 0];
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+int
+runBenchmark(TrainWindow& tw, const char* sceneFile)
+//============================================================================
+{
+	Scene scene;
+	std::string error;
+	if (!loadScene(sceneFile, scene, error)) {
+		std::fprintf(stderr, "%s: %s\n", sceneFile, error.c_str());
+		return 1;
+	}
+
+	TrainView& view = *tw.trainView;
+	if (scene.core)
+		view.backend = TrainView::BACKEND_CORE;
+	if (!scene.track.empty() && !tw.m_Track.readPoints(scene.track.c_str(), error)) {
+		std::fprintf(stderr, "%s: %s\n", scene.track.c_str(), error.c_str());
+		return 1;
+	}
+
+	tw.show();
+	while (!view.shown())
+		Fl::check();
+
+	// the same start every time
+	const float step = static_cast<float>(1.0 / scene.fps);
+	tw.fixedStep = step;
+	tw.simulation.place(0.0f);
+	view.selectedCube = -1;
+	view.resetArcball();
+	view.make_current();
+	view.waitForGeometry();
+
+	std::vector<double> times;
+	times.reserve(scene.frames);
+	size_t nextEvent = 0;
+	const int wasRunning = tw.runButton->value();
+	tw.runButton->value(0);
+	size_t arenaAllocationsAfterWarmup = 0;
+	for (int frame = 0; frame < scene.frames; ++frame) {
+		if (frame == scene.warmup)
+			arenaAllocationsAfterWarmup = view.frameArena.stats().heapAllocations;
+		bool edited = false;
+		for (; nextEvent < scene.events.size() && frameOf(scene.events[nextEvent]) <= frame; ++nextEvent)
+			edited = applyEvent(tw, *scene.events[nextEvent]) || edited;
+		if (edited)
+			view.waitForGeometry();
+		followPath(view, scene.cameraPath, frame);
+		view.sceneTime = frame * step;
+		if (tw.runButton->value())
+			tw.advanceTrain();
+
+		view.make_current();
+		const auto start = std::chrono::steady_clock::now();
+		view.draw();
+		glFinish();
+		const auto end = std::chrono::steady_clock::now();
+		view.swap_buffers();
+		// the widgets that changed, without running the idle callbacks
+		Fl::flush();
+
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	tw.fixedStep = 0.0f;
+	view.sceneTime = -1.0f;
+	tw.runButton->value(wasRunning);
+	tw.updateSimulation();
+
+	if (!scene.output.empty()) {
+		if (FILE* out = std::fopen(scene.output.c_str(), "w")) {
+			std::fprintf(out, "frame,ms\n");
+			for (size_t i = 0; i < times.size(); ++i)
+				std::fprintf(out, "%zu,%.4f\n", i, times[i]);
+			std::fclose(out);
+		}
+		else
+			std::fprintf(stderr, "can't write %s\n", scene.output.c_str());
+	}
+
+	std::vector<double> sorted(times.begin() + scene.warmup, times.end());
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double t : sorted)
+		total += t;
+	const double mean = total / sorted.size();
+	const double p50 = percentile(sorted, 50.0);
+	const double p95 = percentile(sorted, 95.0);
+	const double p99 = percentile(sorted, 99.0);
+	const double worst = sorted.back();
+
+	// the arena should have stopped going to the heap after the warmup
+	const FrameArena::Stats& arena = view.frameArena.stats();
+	const size_t arenaGrowth = arena.heapAllocations - arenaAllocationsAfterWarmup;
+
+	std::printf("%s: %zu frames (%d warmup left out)\n", sceneFile, sorted.size(), scene.warmup);
+	std::printf("  mean %.3f ms  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", mean, p50, p95, p99, worst);
+	std::printf("  frame arena: peak %zu KB, %zu KB held, %zu heap allocations after the warmup\n",
+				arena.peak / 1024, arena.capacity / 1024, arenaGrowth);
+	std::printf("{\"scene\": \"%s\", \"backend\": \"%s\", \"frames\": %zu, \"mean_ms\": %.4f, "
+				"\"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, "
+				"\"arena_peak_kb\": %zu, \"arena_heap_allocations\": %zu}\n",
+				escaped(sceneFile).c_str(), view.backend == TrainView::BACKEND_CORE ? "core" : "legacy",
+				sorted.size(), mean, p50, p95, p99, worst, arena.peak / 1024, arenaGrowth);
+	return 0;
+}
@@ -43,7 +43,7 @@ void resetCB(Fl_Widget*, TrainWindow* tw)
 {
 	tw->m_Track.resetPoints();
 	tw->trainView->selectedCube = -1;
-	tw->m_Track.trainU = 0;
+	tw->simulation.place(0.0f);
 	tw->damageMe();
 }
 
@@ -71,15 +71,19 @@ void addPointCB(Fl_Widget*, TrainWindow* tw)
 
 	// pick a reasonable location
 	size_t previdx = (newidx + npts -1) % npts;
-	Pnt3f npos = (tw->m_Track.points[previdx].pos + tw->m_Track.points[newidx].pos) * .5f;
+	const CTrack& track = tw->m_Track;
+	Pnt3f npos = (track.points[previdx].pos + track.points[newidx].pos) * .5f;
 
-	tw->m_Track.points.insert(tw->m_Track.points.begin() + newidx,npos);
+	tw->m_Track.insertPoint(newidx, ControlPoint(npos));
+	tw->m_Track.markChanged();
 
 	// make it so that the train doesn't move - unless its affected by this control point
 	// it should stay between the same points
-	if (ceil(tw->m_Track.trainU) > ((float)newidx)) {
-		tw->m_Track.trainU += 1;
-		if (tw->m_Track.trainU >= npts) tw->m_Track.trainU -= npts;
+	float trainU = tw->simulation.trainU();
+	if (ceil(trainU) > ((float)newidx)) {
+		trainU += 1;
+		if (trainU >= npts) trainU -= npts;
+		tw->simulation.place(trainU);
 	}
 
 	tw->damageMe();
@@ -94,9 +98,10 @@ void deletePointCB(Fl_Widget*, TrainWindow* tw)
 {
 	if (tw->m_Track.points.size() > 4) {
 		if (tw->trainView->selectedCube >= 0) {
-			tw->m_Track.points.erase(tw->m_Track.points.begin() + tw->trainView->selectedCube);
+			tw->m_Track.erasePoint(tw->trainView->selectedCube);
 		} else
-			tw->m_Track.points.pop_back();
+			tw->m_Track.erasePoint(tw->m_Track.points.size() - 1);
+		tw->m_Track.markChanged();
 	}
 	tw->damageMe();
 }
@@ -121,23 +126,34 @@ void backCB(Fl_Widget*, TrainWindow* tw)
 }
 
 
+//***************************************************************************
+//
+// * The simulation thread wants to know about the run button, the speed
+//   and arc length
+//===========================================================================
+void simulationCB(Fl_Widget*, TrainWindow* tw)
+//===========================================================================
+{
+	tw->updateSimulation();
+	tw->damageMe();
+}
+
 
 static unsigned long lastRedraw = 0;
 //***************************************************************************
 //
 // * Callback for idling - if things are sitting, this gets called
-// if the run button is pushed, then we need to make the train go.
-// This is taken from the old "RunButton" demo.
+// if the run button is pushed, the train is moving (on the simulation
+// thread) and needs drawing again.
 // another nice problem to have - most likely, we'll be too fast
 // don't draw more than 30 times per second
 //===========================================================================
 void runButtonCB(TrainWindow* tw)
 //===========================================================================
 {
-	if (tw->runButton->value()) {	// only advance time if appropriate
+	if (tw->runButton->value()) {	// only redraw if appropriate
 		if (clock() - lastRedraw > CLOCKS_PER_SEC/30) {
 			lastRedraw = clock();
-			tw->advanceTrain();
 			tw->damageMe();
 		}
 	}
@@ -151,11 +167,19 @@ void loadCB(Fl_Widget*, TrainWindow* tw)
 //===========================================================================
 {
 	const char* fname = 
-		fl_file_chooser("Pick a Track File","*.txt","TrackFiles/track.txt");
-	if (fname) {
-		tw->m_Track.readPoints(fname);
-		tw->damageMe();
-	}
+		fl_file_chooser("Pick a Track File","*.{txt,trk}","TrackFiles/track.txt");
+	if (fname)
+		tw->loadTrack(fname);
+}
+
+//***************************************************************************
+//
+// * Stop a track that is loading in the background
+//===========================================================================
+void cancelLoadCB(Fl_Widget*, TrainWindow* tw)
+//===========================================================================
+{
+	tw->cancelLoad();
 }
 //***************************************************************************
 //
@@ -165,7 +189,7 @@ void saveCB(Fl_Widget*, TrainWindow* tw)
 //===========================================================================
 {
 	const char* fname = 
-		fl_input("File name for save (should be *.txt)","TrackFiles/");
+		fl_input("File name for save (*.txt, or *.trk for binary)","TrackFiles/");
 	if (fname)
 		tw->m_Track.writePoints(fname);
 }
@@ -183,6 +207,7 @@ void rollx(TrainWindow* tw, float dir)
 		float co = cos(((float)M_PI_4) * dir);
 		tw->m_Track.points[s].orient.y = co * old.y - si * old.z;
 		tw->m_Track.points[s].orient.z = si * old.y + co * old.z;
+		tw->m_Track.markChanged();
 	}
 	tw->damageMe();
 } 
@@ -223,6 +248,7 @@ void rollz(TrainWindow* tw, float dir)
 
 		tw->m_Track.points[s].orient.y = co * old.y - si * old.x;
 		tw->m_Track.points[s].orient.x = si * old.y + co * old.x;
+		tw->m_Track.markChanged();
 	}
 
 	tw->damageMe();
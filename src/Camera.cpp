@@ -0,0 +1,142 @@
+/************************************************************************
+     File:        Camera.cpp
+
+     Comment:     The cameras, on the CPU. See Camera.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "Camera.H"
+
+#include <cmath>
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "TrackGeometry.H"
+#include "Utilities/ArcBallCam.H"
+
+const float CabCamera::HEIGHT = 5.0f;
+const float CabCamera::LOOK_AHEAD = 25.0f;
+const float CabCamera::SMOOTHING = 0.15f;
+
+//****************************************************************************
+//
+// * gluPerspective, then the arcball's translate and rotation
+//============================================================================
+CameraMatrices worldCamera(const ArcBallCam& arcball, float aspect)
+//============================================================================
+{
+	float eyeX, eyeY, eyeZ;
+	arcball.getEye(eyeX, eyeY, eyeZ);
+	HMatrix rotation;
+	arcball.getMatrix(rotation);
+
+	CameraMatrices camera;
+	camera.projection = glm::perspective(glm::radians(arcball.getFieldOfView()), aspect, 0.1f, 1000.0f);
+	camera.view = glm::translate(glm::mat4(1.0f), glm::vec3(-eyeX, -eyeY, -eyeZ))
+		* glm::make_mat4(asGlMatrix(rotation));
+	return camera;
+}
+
+//****************************************************************************
+//
+// * The world is 220 wide, whichever way round the window is
+//============================================================================
+CameraMatrices topCamera(float aspect)
+//============================================================================
+{
+	float wi, he;
+	if (aspect >= 1) {
+		wi = 110;
+		he = wi / aspect;
+	}
+	else {
+		he = 110;
+		wi = he * aspect;
+	}
+
+	CameraMatrices camera;
+	camera.projection = glm::ortho(-wi, wi, -he, he, 200.0f, -200.0f);
+	camera.view = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1, 0, 0));
+	return camera;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void loadCamera(const CameraMatrices& camera)
+//============================================================================
+{
+	glMatrixMode(GL_PROJECTION);
+	glMultMatrixf(glm::value_ptr(camera.projection));
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(glm::value_ptr(camera.view));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void cameraRay(const CameraMatrices& camera, float x, float y, glm::vec3& from, glm::vec3& to)
+//============================================================================
+{
+	const glm::mat4 unproject = glm::inverse(camera.projection * camera.view);
+	const glm::vec4 nearPoint = unproject * glm::vec4(x, y, -1.0f, 1.0f);
+	const glm::vec4 farPoint = unproject * glm::vec4(x, y, 1.0f, 1.0f);
+	from = glm::vec3(nearPoint) / nearPoint.w;
+	to = glm::vec3(farPoint) / farPoint.w;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool CabCamera::
+update(CameraMatrices& camera, const TrackGeometry& geometry, float trainU,
+	   float fieldOfView, float aspect, float now)
+//============================================================================
+{
+	if (geometry.sleepers.empty())
+		return false;
+
+	const TrackFrame here = geometry.trainFrame(trainU);
+	const TrackFrame ahead = geometry.trainFrame(trainU + LOOK_AHEAD / TrackGeometry::SLEEPER_SPACING);
+	const glm::vec3 hereUp = here.rotation * glm::vec3(0, 1, 0);
+	const glm::vec3 aheadUp = ahead.rotation * glm::vec3(0, 1, 0);
+	const glm::vec3 eye = glm::vec3(here.pos.x, here.pos.y, here.pos.z) + hereUp * HEIGHT;
+	const glm::vec3 target = glm::vec3(ahead.pos.x, ahead.pos.y, ahead.pos.z) + aheadUp * HEIGHT;
+
+	// the rotation that looks at the target, with up halfway between the
+	// two frames
+	glm::vec3 forward = target - eye;
+	if (glm::dot(forward, forward) < 1e-8f)
+		forward = here.rotation * glm::vec3(0, 0, -1);
+	forward = glm::normalize(forward);
+	glm::vec3 up = glm::normalize(hereUp + aheadUp);
+	glm::vec3 right = glm::cross(forward, up);
+	if (glm::dot(right, right) < 1e-8f)
+		right = here.rotation * glm::vec3(1, 0, 0);
+	right = glm::normalize(right);
+	up = glm::cross(right, forward);
+	const glm::quat wanted = glm::normalize(glm::quat_cast(glm::mat3(right, up, -forward)));
+
+	// ease towards it - by the same amount per second at any frame rate.
+	// a long gap (the camera was just switched on) snaps straight there
+	const float dt = now - time;
+	if (time < 0.0f || dt > 0.5f || dt < 0.0f)
+		rotation = wanted;
+	else {
+		const float follow = 1.0f - std::exp(-dt / SMOOTHING);
+		const glm::quat from = (glm::dot(rotation, wanted) < 0.0f) ? -rotation : rotation;
+		rotation = glm::normalize(glm::slerp(from, wanted, follow));
+	}
+	time = now;
+
+	camera.projection = glm::perspective(glm::radians(fieldOfView), aspect, 0.5f, 1000.0f);
+	camera.view = glm::mat4_cast(glm::conjugate(rotation)) * glm::translate(glm::mat4(1.0f), -eye);
+	return true;
+}
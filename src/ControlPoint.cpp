@@ -24,12 +24,7 @@
 
 *************************************************************************/
 
-#include <windows.h>
-#include <GL/gl.h>
-#include <math.h>
-
 #include "ControlPoint.H"
-#include "Utilities/3dUtils.h"
 
 //****************************************************************************
 //
@@ -64,70 +59,3 @@ ControlPoint(const Pnt3f &_pos, const Pnt3f &_orient)
 {
 	orient.normalize();
 }
-
-//****************************************************************************
-//
-// * Draw the control point
-//============================================================================
-void ControlPoint::
-draw()
-//============================================================================
-{
-	float size=2.0;
-
-	glPushMatrix();
-	glTranslatef(pos.x,pos.y,pos.z);
-	float theta1 = -radiansToDegrees(atan2(orient.z,orient.x));
-	glRotatef(theta1,0,1,0);
-	float theta2 = -radiansToDegrees(acos(orient.y));
-	glRotatef(theta2,0,0,1);
-
-		glBegin(GL_QUADS);
-			glNormal3f( 0,0,1);
-			glVertex3f( size, size, size);
-			glVertex3f(-size, size, size);
-			glVertex3f(-size,-size, size);
-			glVertex3f( size,-size, size);
-
-			glNormal3f( 0, 0, -1);
-			glVertex3f( size, size, -size);
-			glVertex3f( size,-size, -size);
-			glVertex3f(-size,-size, -size);
-			glVertex3f(-size, size, -size);
-
-			// no top - it will be the point
-
-			glNormal3f( 0,-1,0);
-			glVertex3f( size,-size, size);
-			glVertex3f(-size,-size, size);
-			glVertex3f(-size,-size,-size);
-			glVertex3f( size,-size,-size);
-
-			glNormal3f( 1,0,0);
-			glVertex3f( size, size, size);
-			glVertex3f( size,-size, size);
-			glVertex3f( size,-size,-size);
-			glVertex3f( size, size,-size);
-
-			glNormal3f(-1,0,0);
-			glVertex3f(-size, size, size);
-			glVertex3f(-size, size,-size);
-			glVertex3f(-size,-size,-size);
-			glVertex3f(-size,-size, size);
-		glEnd();
-		glBegin(GL_TRIANGLE_FAN);
-			glNormal3f(0,1.0f,0);
-			glVertex3f(0,3.0f*size,0);
-			glNormal3f( 1.0f, 0.0f , 1.0f);
-			glVertex3f( size, size , size);
-			glNormal3f(-1.0f, 0.0f , 1.0f);
-			glVertex3f(-size, size , size);
-			glNormal3f(-1.0f, 0.0f ,-1.0f);
-			glVertex3f(-size, size ,-size);
-			glNormal3f( 1.0f, 0.0f ,-1.0f);
-			glVertex3f( size, size ,-size);
-			glNormal3f( 1.0f, 0.0f , 1.0f);
-			glVertex3f( size, size , size);
-		glEnd();
-	glPopMatrix();
-}
\ No newline at end of file
@@ -0,0 +1,629 @@
+/************************************************************************
+     File:        ControlPointList.cpp
+
+     Comment:     Chunked control point storage. See ControlPointList.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "ControlPointList.H"
+
+#include <cstring>
+#include <utility>
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPoint ControlPointList::const_iterator::
+operator*() const
+//============================================================================
+{
+	return list->chunks[chunk]->point(offset);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::Id ControlPointList::const_iterator::
+id() const
+//============================================================================
+{
+	return list->chunks[chunk]->ids[offset];
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::const_iterator& ControlPointList::const_iterator::
+operator++()
+//============================================================================
+{
+	if (++offset == list->chunks[chunk]->size) {
+		++chunk;
+		offset = 0;
+	}
+	return *this;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::
+ControlPointList()
+	: topStep(0), owners(std::make_shared<std::vector<size_t>>()), nextKey(0), count(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * The chunks and the ids are shared, not copied - whichever list
+//   changes one first copies it then (see writable)
+//============================================================================
+ControlPointList::
+ControlPointList(const ControlPointList& other)
+	: chunks(other.chunks), tree(other.tree), topStep(other.topStep), owners(other.owners),
+	  orders(other.orders), nextKey(other.nextKey), count(other.count)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList& ControlPointList::
+operator=(const ControlPointList& other)
+//============================================================================
+{
+	if (this != &other) {
+		ControlPointList copy(other);
+		swap(copy);
+	}
+	return *this;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::
+ControlPointList(ControlPointList&& other) noexcept
+	: topStep(0), owners(std::make_shared<std::vector<size_t>>()), nextKey(0), count(0)
+//============================================================================
+{
+	swap(other);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList& ControlPointList::
+operator=(ControlPointList&& other) noexcept
+//============================================================================
+{
+	swap(other);
+	return *this;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointRef ControlPointList::
+operator[](size_t i)
+//============================================================================
+{
+	size_t chunk, offset;
+	locate(i, chunk, offset);
+	Chunk& in = writable(chunk);
+	return ControlPointRef(Pnt3fRef(in.x[offset], in.y[offset], in.z[offset]),
+						   Pnt3fRef(in.ox[offset], in.oy[offset], in.oz[offset]));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPoint ControlPointList::
+operator[](size_t i) const
+//============================================================================
+{
+	size_t chunk, offset;
+	locate(i, chunk, offset);
+	return chunks[chunk]->point(offset);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::Id ControlPointList::
+id(size_t i) const
+//============================================================================
+{
+	size_t chunk, offset;
+	locate(i, chunk, offset);
+	return chunks[chunk]->ids[offset];
+}
+
+//****************************************************************************
+//
+// * The chunk is known from the id, the place in it takes a look through
+//   its ids
+//============================================================================
+size_t ControlPointList::
+indexOf(Id id) const
+//============================================================================
+{
+	if (id >= owners->size() || (*owners)[id] == NO_CHUNK)
+		return NOT_FOUND;
+	const size_t order = orders[(*owners)[id]];
+	const Chunk& chunk = *chunks[order];
+	for (size_t offset = 0; offset < chunk.size; ++offset)
+		if (chunk.ids[offset] == id)
+			return pointsBefore(order) + offset;
+	return NOT_FOUND;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::Id ControlPointList::
+insert(size_t i, const ControlPoint& point)
+//============================================================================
+{
+	if (chunks.empty()) {
+		chunks.push_back(newChunk());
+		rebuildIndex();
+	}
+
+	size_t chunk, offset;
+	if (i >= count) {
+		chunk = chunks.size() - 1;
+		offset = chunks[chunk]->size;
+	}
+	else
+		locate(i, chunk, offset);
+
+	Chunk& into = writable(chunk);
+	into.open(offset);
+	into.set(offset, point);
+	const Id id = newId(into.key);
+	into.ids[offset] = id;
+	++count;
+	addToCount(chunk, 1);
+
+	if (into.size >= MAX_CHUNK)
+		split(chunk);
+	return id;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::
+erase(size_t i)
+//============================================================================
+{
+	if (i >= count)
+		return;
+	size_t chunk, offset;
+	locate(i, chunk, offset);
+
+	Chunk& from = writable(chunk);
+	writableOwners()[from.ids[offset]] = NO_CHUNK;
+	from.close(offset);
+	--count;
+	addToCount(chunk, -1);
+
+	if (from.size == 0) {
+		chunks.erase(chunks.begin() + chunk);
+		rebuildIndex();
+	}
+	else
+		mergeIfSmall(chunk);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::
+clear()
+//============================================================================
+{
+	chunks.clear();
+	// a copy may still be using the old ids
+	owners = std::make_shared<std::vector<size_t>>();
+	orders.clear();
+	nextKey = 0;
+	count = 0;
+	rebuildIndex();
+}
+
+//****************************************************************************
+//
+// * Chunks filled to FILL, so the first edits don't split them straight
+//   away
+//============================================================================
+void ControlPointList::
+assign(const std::vector<ControlPoint>& points)
+//============================================================================
+{
+	clear();
+	owners->reserve(points.size());
+	for (size_t start = 0; start < points.size(); start += FILL) {
+		const size_t end = (start + FILL < points.size()) ? start + FILL : points.size();
+		chunks.push_back(newChunk());
+		Chunk& chunk = *chunks.back();
+		for (size_t i = start; i < end; ++i) {
+			chunk.set(i - start, points[i]);
+			chunk.ids[i - start] = newId(chunk.key);
+		}
+		chunk.size = end - start;
+	}
+	count = points.size();
+	rebuildIndex();
+}
+
+//****************************************************************************
+//
+// * The floats are pulled apart into the arrays as they are, a chunk at a
+//   time - no ControlPoints in between
+//============================================================================
+void ControlPointList::
+assign(const float* interleaved, size_t pointCount)
+//============================================================================
+{
+	clear();
+	owners->reserve(pointCount);
+	for (size_t start = 0; start < pointCount; start += FILL) {
+		const size_t end = (start + FILL < pointCount) ? start + FILL : pointCount;
+		chunks.push_back(newChunk());
+		Chunk& chunk = *chunks.back();
+		const float* from = interleaved + start * 6;
+		for (size_t i = 0; i < end - start; ++i, from += 6) {
+			chunk.x[i] = from[0];
+			chunk.y[i] = from[1];
+			chunk.z[i] = from[2];
+			chunk.ox[i] = from[3];
+			chunk.oy[i] = from[4];
+			chunk.oz[i] = from[5];
+			chunk.ids[i] = newId(chunk.key);
+		}
+		chunk.size = end - start;
+	}
+	count = pointCount;
+	rebuildIndex();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::
+swap(ControlPointList& other) noexcept
+//============================================================================
+{
+	chunks.swap(other.chunks);
+	tree.swap(other.tree);
+	std::swap(topStep, other.topStep);
+	owners.swap(other.owners);
+	orders.swap(other.orders);
+	std::swap(nextKey, other.nextKey);
+	std::swap(count, other.count);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::
+copyTo(std::vector<ControlPoint>& out) const
+//============================================================================
+{
+	out.clear();
+	out.reserve(count);
+	for (const std::shared_ptr<Chunk>& chunk : chunks)
+		for (size_t i = 0; i < chunk->size; ++i)
+			out.push_back(chunk->point(i));
+}
+
+//****************************************************************************
+//
+// * Whole chunks, however full they are - and counted again by every list
+//   sharing them
+//============================================================================
+size_t ControlPointList::
+memoryUsed() const
+//============================================================================
+{
+	return chunks.size() * sizeof(Chunk)
+		+ chunks.capacity() * sizeof(std::shared_ptr<Chunk>)
+		+ tree.capacity() * sizeof(size_t)
+		+ owners->capacity() * sizeof(size_t)
+		+ orders.capacity() * sizeof(size_t);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::Span ControlPointList::
+chunk(size_t c) const
+//============================================================================
+{
+	const Chunk& from = *chunks[c];
+	Span span;
+	span.x = from.x;
+	span.y = from.y;
+	span.z = from.z;
+	span.ox = from.ox;
+	span.oy = from.oy;
+	span.oz = from.oz;
+	span.ids = from.ids;
+	span.count = from.size;
+	return span;
+}
+
+//****************************************************************************
+//
+// * Down the Fenwick tree: the last chunk whose points before it are
+//   still no more than i
+//============================================================================
+void ControlPointList::
+locate(size_t i, size_t& chunk, size_t& offset) const
+//============================================================================
+{
+	size_t position = 0;
+	size_t rest = i;
+	for (size_t step = topStep; step > 0; step >>= 1) {
+		const size_t next = position + step;
+		if (next < tree.size() && tree[next] <= rest) {
+			position = next;
+			rest -= tree[next];
+		}
+	}
+	chunk = position;
+	offset = rest;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+size_t ControlPointList::
+pointsBefore(size_t chunk) const
+//============================================================================
+{
+	size_t sum = 0;
+	for (size_t k = chunk; k > 0; k -= k & (~k + 1))
+		sum += tree[k];
+	return sum;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::
+addToCount(size_t chunk, std::ptrdiff_t delta)
+//============================================================================
+{
+	for (size_t k = chunk + 1; k < tree.size(); k += k & (~k + 1))
+		tree[k] += static_cast<size_t>(delta);
+}
+
+//****************************************************************************
+//
+// * In O(chunks): every node gets its own chunk, then hands its sum on to
+//   its parent
+//============================================================================
+void ControlPointList::
+rebuildIndex()
+//============================================================================
+{
+	const size_t n = chunks.size();
+	tree.assign(n + 1, 0);
+	orders.resize(nextKey);
+	for (size_t c = 0; c < n; ++c) {
+		orders[chunks[c]->key] = c;
+		tree[c + 1] += chunks[c]->size;
+		const size_t parent = (c + 1) + ((c + 1) & (~(c + 1) + 1));
+		if (parent <= n)
+			tree[parent] += tree[c + 1];
+	}
+	topStep = 0;
+	if (n > 0) {
+		topStep = 1;
+		while (topStep * 2 <= n)
+			topStep *= 2;
+	}
+}
+
+//****************************************************************************
+//
+// * The back half moves to a new chunk after it
+//============================================================================
+void ControlPointList::
+split(size_t chunk)
+//============================================================================
+{
+	Chunk& full = writable(chunk);
+	std::shared_ptr<Chunk> back = newChunk();
+	full.moveTail(full.size / 2, *back);
+	std::vector<size_t>& keys = writableOwners();
+	for (size_t i = 0; i < back->size; ++i)
+		keys[back->ids[i]] = back->key;
+
+	chunks.insert(chunks.begin() + chunk + 1, std::move(back));
+	rebuildIndex();
+}
+
+//****************************************************************************
+//
+// * A chunk that ran low goes into the next one (or the one before, at
+//   the end) - if the two fit in three quarters of a chunk, so the
+//   merged one is not split again by the next few inserts
+//============================================================================
+void ControlPointList::
+mergeIfSmall(size_t chunk)
+//============================================================================
+{
+	if (chunks[chunk]->size >= MAX_CHUNK / 4 || chunks.size() < 2)
+		return;
+	const size_t first = (chunk + 1 < chunks.size()) ? chunk : chunk - 1;
+	if (chunks[first]->size + chunks[first + 1]->size > MAX_CHUNK * 3 / 4)
+		return;
+	Chunk& into = writable(first);
+	Chunk& from = writable(first + 1);
+
+	std::vector<size_t>& keys = writableOwners();
+	for (size_t i = 0; i < from.size; ++i)
+		keys[from.ids[i]] = into.key;
+	from.moveTail(0, into);
+	chunks.erase(chunks.begin() + first + 1);
+	rebuildIndex();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPointList::Id ControlPointList::
+newId(size_t key)
+//============================================================================
+{
+	std::vector<size_t>& keys = writableOwners();
+	keys.push_back(key);
+	return static_cast<Id>(keys.size() - 1);
+}
+
+//****************************************************************************
+//
+// * A chunk another list holds too is copied before it is changed. the
+//   copy keeps the key, so the ids still find it. (use_count can only go
+//   down behind our back - at worst a chunk is copied that no longer had
+//   to be)
+//============================================================================
+ControlPointList::Chunk& ControlPointList::
+writable(size_t chunk)
+//============================================================================
+{
+	std::shared_ptr<Chunk>& held = chunks[chunk];
+	if (held.use_count() > 1)
+		held = std::shared_ptr<Chunk>(new Chunk(*held));
+	return *held;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+std::vector<size_t>& ControlPointList::
+writableOwners()
+//============================================================================
+{
+	if (owners.use_count() > 1)
+		owners = std::make_shared<std::vector<size_t>>(*owners);
+	return *owners;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+std::shared_ptr<ControlPointList::Chunk> ControlPointList::
+newChunk()
+//============================================================================
+{
+	std::shared_ptr<Chunk> chunk(new Chunk());
+	chunk->key = nextKey++;
+	return chunk;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+ControlPoint ControlPointList::Chunk::
+point(size_t i) const
+//============================================================================
+{
+	return ControlPoint(Pnt3f(x[i], y[i], z[i]), Pnt3f(ox[i], oy[i], oz[i]));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::Chunk::
+set(size_t i, const ControlPoint& point)
+//============================================================================
+{
+	x[i] = point.pos.x;
+	y[i] = point.pos.y;
+	z[i] = point.pos.z;
+	ox[i] = point.orient.x;
+	oy[i] = point.orient.y;
+	oz[i] = point.orient.z;
+}
+
+//****************************************************************************
+//
+// * Every array shifts up by one from i
+//============================================================================
+void ControlPointList::Chunk::
+open(size_t i)
+//============================================================================
+{
+	const size_t moved = size - i;
+	for (float* a : { x, y, z, ox, oy, oz })
+		std::memmove(a + i + 1, a + i, moved * sizeof(float));
+	std::memmove(ids + i + 1, ids + i, moved * sizeof(Id));
+	++size;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::Chunk::
+close(size_t i)
+//============================================================================
+{
+	const size_t moved = size - i - 1;
+	for (float* a : { x, y, z, ox, oy, oz })
+		std::memmove(a + i, a + i + 1, moved * sizeof(float));
+	std::memmove(ids + i, ids + i + 1, moved * sizeof(Id));
+	--size;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ControlPointList::Chunk::
+moveTail(size_t from, Chunk& other)
+//============================================================================
+{
+	const size_t moved = size - from;
+	std::memcpy(other.x + other.size, x + from, moved * sizeof(float));
+	std::memcpy(other.y + other.size, y + from, moved * sizeof(float));
+	std::memcpy(other.z + other.size, z + from, moved * sizeof(float));
+	std::memcpy(other.ox + other.size, ox + from, moved * sizeof(float));
+	std::memcpy(other.oy + other.size, oy + from, moved * sizeof(float));
+	std::memcpy(other.oz + other.size, oz + from, moved * sizeof(float));
+	std::memcpy(other.ids + other.size, ids + from, moved * sizeof(Id));
+	other.size += moved;
+	size = from;
+}
@@ -0,0 +1,658 @@
+/************************************************************************
+     File:        CoreRenderer.cpp
+
+     Comment:     The core-profile renderer. See CoreRenderer.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "CoreRenderer.H"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "RenderUtilities/BufferObject.h"
+#include "RenderUtilities/Shader.h"
+#include "TrackGeometry.H"
+
+namespace {
+	const int MAX_LIGHTS = 4;		// as in mesh.frag
+
+	struct MeshData {
+		std::vector<GLfloat>	vertices;	// x y z nx ny nz
+		std::vector<GLfloat>	colors;		// r g b a, empty for none
+		std::vector<GLuint>		indices;
+	};
+
+	void addVertex(MeshData& data, const glm::vec3& p, const glm::vec3& n)
+	{
+		data.vertices.insert(data.vertices.end(), { p.x, p.y, p.z, n.x, n.y, n.z });
+	}
+
+	// a quad as two triangles, counter-clockwise like the glBegin(GL_QUADS)
+	// it replaces
+	void addQuad(MeshData& data, const glm::vec3& p0, const glm::vec3& p1,
+				 const glm::vec3& p2, const glm::vec3& p3, const glm::vec3& n)
+	{
+		const GLuint first = static_cast<GLuint>(data.vertices.size() / 6);
+		addVertex(data, p0, n);
+		addVertex(data, p1, n);
+		addVertex(data, p2, n);
+		addVertex(data, p3, n);
+		data.indices.insert(data.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+
+	void uploadMesh(CoreMesh& mesh, const MeshData& data)
+	{
+		if (!mesh.vao) {
+			genVertexArrays(1, &mesh.vao, "CoreRenderer meshes");
+			genBuffers(1, &mesh.vertices, "CoreRenderer meshes");
+			genBuffers(1, &mesh.indices, "CoreRenderer meshes");
+		}
+		glBindVertexArray(mesh.vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vertices);
+		bufferData(GL_ARRAY_BUFFER, mesh.vertices, data.vertices.size() * sizeof(GLfloat), data.vertices.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(1);
+
+		if (!data.colors.empty()) {
+			if (!mesh.colors)
+				genBuffers(1, &mesh.colors, "CoreRenderer meshes");
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.colors);
+			bufferData(GL_ARRAY_BUFFER, mesh.colors, data.colors.size() * sizeof(GLfloat), data.colors.data(), GL_STATIC_DRAW);
+			glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+			glEnableVertexAttribArray(2);
+		}
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indices);
+		bufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices, data.indices.size() * sizeof(GLuint), data.indices.data(), GL_STATIC_DRAW);
+		mesh.count = static_cast<GLsizei>(data.indices.size());
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void deleteMesh(CoreMesh& mesh)
+	{
+		deleteBuffers(1, &mesh.vertices);
+		deleteBuffers(1, &mesh.indices);
+		if (mesh.colors)
+			deleteBuffers(1, &mesh.colors);
+		deleteVertexArrays(1, &mesh.vao);
+		mesh = CoreMesh();
+	}
+
+	// the checkerboard of drawFloor(200, 10)
+	MeshData makeFloor()
+	{
+		const float size = 200.0f;
+		const int squares = 10;
+		const glm::vec4 light(0.7f, 0.7f, 0.7f, 1.0f);
+		const glm::vec4 dark(0.3f, 0.3f, 0.3f, 1.0f);
+		const float d = size / squares;
+		const glm::vec3 up(0, 1, 0);
+
+		MeshData data;
+		for (int x = 0; x < squares; ++x) {
+			for (int y = 0; y < squares; ++y) {
+				const float xp = -size / 2 + x * d;
+				const float yp = -size / 2 + y * d;
+				addQuad(data, glm::vec3(xp, 0, yp), glm::vec3(xp, 0, yp + d),
+						glm::vec3(xp + d, 0, yp + d), glm::vec3(xp + d, 0, yp), up);
+				const glm::vec4& color = ((x + y) % 2 == 1) ? light : dark;
+				for (int corner = 0; corner < 4; ++corner)
+					data.colors.insert(data.colors.end(), { color.r, color.g, color.b, color.a });
+			}
+		}
+		return data;
+	}
+
+	// a control point: a box with a point on top, up along y
+	MeshData makeControlPoint()
+	{
+		const float s = 2.0f;
+		MeshData data;
+		addQuad(data, { s, s, s }, { -s, s, s }, { -s, -s, s }, { s, -s, s }, { 0, 0, 1 });
+		addQuad(data, { s, s, -s }, { s, -s, -s }, { -s, -s, -s }, { -s, s, -s }, { 0, 0, -1 });
+		addQuad(data, { s, -s, s }, { -s, -s, s }, { -s, -s, -s }, { s, -s, -s }, { 0, -1, 0 });
+		addQuad(data, { s, s, s }, { s, -s, s }, { s, -s, -s }, { s, s, -s }, { 1, 0, 0 });
+		addQuad(data, { -s, s, s }, { -s, s, -s }, { -s, -s, -s }, { -s, -s, s }, { -1, 0, 0 });
+
+		const glm::vec3 apex(0, 3.0f * s, 0);
+		const glm::vec3 corners[5] = { { s, s, s }, { -s, s, s }, { -s, s, -s }, { s, s, -s }, { s, s, s } };
+		for (int i = 0; i < 4; ++i) {
+			const GLuint first = static_cast<GLuint>(data.vertices.size() / 6);
+			addVertex(data, apex, glm::vec3(0, 1, 0));
+			addVertex(data, corners[i], glm::normalize(glm::vec3(corners[i].x, 0, corners[i].z)));
+			addVertex(data, corners[i + 1], glm::normalize(glm::vec3(corners[i + 1].x, 0, corners[i + 1].z)));
+			data.indices.insert(data.indices.end(), { first, first + 1, first + 2 });
+		}
+		return data;
+	}
+
+	// a cube from -1 to 1, scaled and turned into place when drawn
+	MeshData makeCube()
+	{
+		MeshData data;
+		addQuad(data, { -1, -1, -1 }, { 1, -1, -1 }, { 1, -1, 1 }, { -1, -1, 1 }, { 0, -1, 0 });
+		addQuad(data, { -1, 1, -1 }, { -1, 1, 1 }, { 1, 1, 1 }, { 1, 1, -1 }, { 0, 1, 0 });
+		addQuad(data, { -1, -1, -1 }, { -1, -1, 1 }, { -1, 1, 1 }, { -1, 1, -1 }, { -1, 0, 0 });
+		addQuad(data, { 1, -1, -1 }, { 1, 1, -1 }, { 1, 1, 1 }, { 1, -1, 1 }, { 1, 0, 0 });
+		addQuad(data, { -1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 }, { 1, -1, -1 }, { 0, 0, -1 });
+		addQuad(data, { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 }, { 0, 0, 1 });
+		return data;
+	}
+}
+
+//****************************************************************************
+//
+// * Constructor - needs the GL context to be current
+//============================================================================
+CoreRenderer::
+CoreRenderer()
+	: current(0), instanceCapacity(0), instancesVisit(0), instancesRevision(0), instancesSelected(-1),
+	  instancesValid(false), shadowPass(false), shadowMatrix(1.0f)
+//============================================================================
+{
+	loadProgram(meshProgram, "./shaders/mesh.vert", "./shaders/mesh.frag");
+	loadProgram(gizmoProgram, "./shaders/gizmo.vert", "./shaders/mesh.frag");
+
+	genBuffers(1, &matrices, "CoreRenderer");
+	glBindBuffer(GL_UNIFORM_BUFFER, matrices);
+	bufferData(GL_UNIFORM_BUFFER, matrices, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	genVertexArrays(1, &railVao, "CoreRenderer");
+
+	uploadMesh(floor, makeFloor());
+	uploadMesh(controlPoint, makeControlPoint());
+	uploadMesh(train, makeCube());
+
+	// the gizmo mesh again, plus one position and rotation per instance
+	genVertexArrays(1, &gizmoVao, "CoreRenderer");
+	genBuffers(1, &instanceBuffer, "CoreRenderer instances");
+	glBindVertexArray(gizmoVao);
+	glBindBuffer(GL_ARRAY_BUFFER, controlPoint.vertices);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(ControlPointInstance),
+						  (GLvoid*)offsetof(ControlPointInstance, position));
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(ControlPointInstance),
+						  (GLvoid*)offsetof(ControlPointInstance, rotation));
+	glEnableVertexAttribArray(4);
+	glVertexAttribDivisor(4, 1);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, controlPoint.indices);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the same squash as setupShadows: y goes to 0
+	shadowMatrix[1][1] = 0.0f;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+CoreRenderer::
+~CoreRenderer()
+//============================================================================
+{
+	deleteMesh(floor);
+	deleteMesh(controlPoint);
+	deleteMesh(train);
+	if (sleepers.vao)
+		deleteMesh(sleepers);
+	deleteVertexArrays(1, &gizmoVao);
+	deleteBuffers(1, &instanceBuffer);
+	deleteVertexArrays(1, &railVao);
+	deleteBuffers(1, &matrices);
+	for (Program* program : { &meshProgram, &gizmoProgram })
+		delete program->shader;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void CoreRenderer::
+loadProgram(Program& program, const char* vertex, const char* fragment)
+//============================================================================
+{
+	program.shader = new Shader(vertex, nullptr, nullptr, nullptr, fragment);
+	const GLuint id = program.shader->Program;
+	program.model = glGetUniformLocation(id, "u_model");
+	program.normalMatrix = glGetUniformLocation(id, "u_normal_matrix");
+	program.color = glGetUniformLocation(id, "u_color");
+	program.lit = glGetUniformLocation(id, "u_lit");
+	program.specular = glGetUniformLocation(id, "u_specular");
+	program.shininess = glGetUniformLocation(id, "u_shininess");
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void CoreRenderer::
+use(const Program& program)
+//============================================================================
+{
+	if (current != program.shader->Program) {
+		current = program.shader->Program;
+		glUseProgram(current);
+	}
+}
+
+//****************************************************************************
+//
+// * The lights are the ones draw() sets up for the fixed-function path,
+//   already in world space
+//============================================================================
+void CoreRenderer::
+beginFrame(const CameraMatrices& camera, int lighting)
+//============================================================================
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, matrices);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(camera.projection));
+	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(camera.view));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, matrices);
+
+	glm::vec4 position[MAX_LIGHTS];
+	glm::vec3 ambient[MAX_LIGHTS];
+	glm::vec3 diffuse[MAX_LIGHTS];
+	glm::vec4 spot[MAX_LIGHTS];
+	float exponent[MAX_LIGHTS];
+	glm::vec3 globalAmbient(0.2f);
+	int count = 0;
+	for (int i = 0; i < MAX_LIGHTS; ++i) {
+		ambient[i] = glm::vec3(0.0f);
+		spot[i] = glm::vec4(0, 0, -1, -1);
+		exponent[i] = 0.0f;
+	}
+
+	if (lighting == LIGHTS_SPOT) {
+		position[0] = glm::vec4(0, 100, 0, 1);
+		ambient[0] = glm::vec3(0.02f, 0.03f, 0.08f);
+		diffuse[0] = glm::vec3(0.2f, 0.35f, 1.0f);
+		spot[0] = glm::vec4(0, -1, 0, std::cos(glm::radians(35.0f)));
+		exponent[0] = 8.0f;
+		globalAmbient = glm::vec3(0.12f);
+		count = 1;
+	}
+	else {
+		if (lighting == LIGHTS_DIRECTIONAL) {
+			position[0] = glm::vec4(1, 1, 0, 0);
+			diffuse[0] = glm::vec3(1.0f);
+		}
+		else {
+			position[0] = glm::vec4(0, 1, 1, 0);
+			ambient[0] = glm::vec3(0.3f);
+			diffuse[0] = glm::vec3(1.0f);
+		}
+		position[1] = glm::vec4(1, 0, 0, 0);
+		diffuse[1] = glm::vec3(0.5f, 0.5f, 0.1f);
+		position[2] = glm::vec4(0, -1, 0, 0);
+		diffuse[2] = glm::vec3(0.1f, 0.1f, 0.3f);
+		count = 3;
+	}
+
+	// both programs light with mesh.frag. someone else may have changed
+	// the program since the last frame
+	const glm::vec3 eye = glm::vec3(glm::inverse(camera.view)[3]);
+	current = 0;
+	for (const Program* p : { &gizmoProgram, &meshProgram }) {
+		use(*p);
+		const GLuint program = p->shader->Program;
+		glUniform1i(glGetUniformLocation(program, "u_light_count"), count);
+		glUniform4fv(glGetUniformLocation(program, "u_light_position"), MAX_LIGHTS, glm::value_ptr(position[0]));
+		glUniform3fv(glGetUniformLocation(program, "u_light_ambient"), MAX_LIGHTS, glm::value_ptr(ambient[0]));
+		glUniform3fv(glGetUniformLocation(program, "u_light_diffuse"), MAX_LIGHTS, glm::value_ptr(diffuse[0]));
+		glUniform4fv(glGetUniformLocation(program, "u_light_spot"), MAX_LIGHTS, glm::value_ptr(spot[0]));
+		glUniform1fv(glGetUniformLocation(program, "u_light_exponent"), MAX_LIGHTS, exponent);
+		glUniform3fv(glGetUniformLocation(program, "u_ambient"), 1, glm::value_ptr(globalAmbient));
+		glUniform3fv(glGetUniformLocation(program, "u_camera"), 1, glm::value_ptr(eye));
+	}
+}
+
+//****************************************************************************
+//
+// * setupShadows without the matrix stack: only where the floor is
+//   (stencil), no depth test, blended
+//============================================================================
+void CoreRenderer::
+beginShadows()
+//============================================================================
+{
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_EQUAL, 0x1, 0x1);
+	glStencilOp(GL_KEEP, GL_ZERO, GL_ZERO);
+	glStencilMask(0x1);
+
+	shadowPass = true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void CoreRenderer::
+endShadows()
+//============================================================================
+{
+	shadowPass = false;
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_BLEND);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void CoreRenderer::
+drawFloor(bool lit)
+//============================================================================
+{
+	CoreMaterial material;
+	material.lit = lit;
+	draw(floor, glm::mat4(1.0f), material);
+}
+
+//****************************************************************************
+//
+// * One instanced draw for all of them
+//============================================================================
+void CoreRenderer::
+drawControlPoints(const ControlPointList& points, unsigned revision, int selected)
+//============================================================================
+{
+	if (!instancesValid || revision != instancesRevision || selected != instancesSelected
+		|| points.size() != instances.size()) {
+		updateControlPoints(points, selected);
+		instancesRevision = revision;
+		instancesSelected = selected;
+		instancesValid = true;
+	}
+	if (instances.empty())
+		return;
+
+	setMaterial(gizmoProgram, glm::mat4(1.0f), CoreMaterial());
+	glBindVertexArray(gizmoVao);
+	glDrawElementsInstanced(GL_TRIANGLES, controlPoint.count, GL_UNSIGNED_INT, (GLvoid*)0,
+							static_cast<GLsizei>(instances.size()));
+	glBindVertexArray(0);
+}
+
+//****************************************************************************
+//
+// * Rewrite the instances of the points that moved, turned or were
+//   (de)selected, a run of neighbouring slots at a time. a new point gets
+//   a slot at the end, and the slot of a deleted one is filled with the
+//   last slot - so adding or deleting a point writes a slot or two,
+//   wherever in the track it is
+//   the rotation turns y onto the point's orientation: about y by the
+//   heading, then about z by the tilt
+//============================================================================
+void CoreRenderer::
+updateControlPoints(const ControlPointList& points, int selected)
+//============================================================================
+{
+	const size_t NO_SLOT = static_cast<size_t>(-1);
+	if (!instancesValid) {
+		instances.clear();
+		pointSources.clear();
+		slotIds.clear();
+		slotSeen.clear();
+		slotDirty.clear();
+		slotOf.clear();
+	}
+	const unsigned visit = ++instancesVisit;
+
+	auto same = [](const Pnt3f& a, const Pnt3f& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	};
+
+	size_t i = 0;
+	for (ControlPointList::const_iterator p = points.begin(); p != points.end(); ++p, ++i) {
+		const ControlPoint& point = *p;
+		const ControlPointList::Id id = p.id();
+		if (id >= slotOf.size())
+			slotOf.resize(static_cast<size_t>(id) + 1, NO_SLOT);
+
+		size_t slot = slotOf[id];
+		if (slot == NO_SLOT) {
+			slot = instances.size();
+			slotOf[id] = slot;
+			instances.emplace_back();
+			pointSources.push_back(point);
+			slotIds.push_back(id);
+			slotSeen.push_back(visit);
+			slotDirty.push_back(1);
+		}
+		slotSeen[slot] = visit;
+
+		const bool isSelected = static_cast<int>(i) == selected;
+		if (!slotDirty[slot] && same(point.pos, pointSources[slot].pos)
+			&& same(point.orient, pointSources[slot].orient)
+			&& isSelected == (instances[slot].position[3] > 0.5f))
+			continue;
+
+		const Pnt3f& orient = point.orient;
+		const glm::quat rotation =
+			glm::angleAxis(-std::atan2(orient.z, orient.x), glm::vec3(0, 1, 0))
+			* glm::angleAxis(-std::acos(std::max(-1.0f, std::min(1.0f, orient.y))), glm::vec3(0, 0, 1));
+		ControlPointInstance& instance = instances[slot];
+		instance.position[0] = point.pos.x;
+		instance.position[1] = point.pos.y;
+		instance.position[2] = point.pos.z;
+		instance.position[3] = isSelected ? 1.0f : 0.0f;
+		instance.rotation[0] = rotation.x;
+		instance.rotation[1] = rotation.y;
+		instance.rotation[2] = rotation.z;
+		instance.rotation[3] = rotation.w;
+		pointSources[slot] = point;
+		slotDirty[slot] = 1;
+	}
+
+	// the slots of the points that are gone get the last slot moved in
+	for (size_t slot = 0; slot < instances.size();) {
+		if (slotSeen[slot] == visit) {
+			++slot;
+			continue;
+		}
+		if (slotOf[slotIds[slot]] == slot)
+			slotOf[slotIds[slot]] = NO_SLOT;
+		const size_t last = instances.size() - 1;
+		if (slot != last) {
+			instances[slot] = instances[last];
+			pointSources[slot] = pointSources[last];
+			slotIds[slot] = slotIds[last];
+			slotSeen[slot] = slotSeen[last];
+			slotDirty[slot] = 1;
+			slotOf[slotIds[slot]] = slot;
+		}
+		instances.pop_back();
+		pointSources.pop_back();
+		slotIds.pop_back();
+		slotSeen.pop_back();
+		slotDirty.pop_back();
+	}
+
+	const size_t count = instances.size();
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	if (count > instanceCapacity) {
+		instanceCapacity = std::max<size_t>(count, std::max<size_t>(64, instanceCapacity * 2));
+		bufferData(GL_ARRAY_BUFFER, instanceBuffer, instanceCapacity * sizeof(ControlPointInstance), NULL, GL_DYNAMIC_DRAW);
+		std::fill(slotDirty.begin(), slotDirty.end(), 1);
+	}
+
+	size_t runStart = count;
+	for (size_t slot = 0; slot <= count; ++slot) {
+		const bool dirty = slot < count && slotDirty[slot];
+		if (dirty) {
+			slotDirty[slot] = 0;
+			if (runStart == count)
+				runStart = slot;
+		}
+		else if (runStart != count) {
+			glBufferSubData(GL_ARRAY_BUFFER, runStart * sizeof(ControlPointInstance),
+							(slot - runStart) * sizeof(ControlPointInstance), &instances[runStart]);
+			runStart = count;
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//****************************************************************************
+//
+// * The train cube rides on top of the track
+//============================================================================
+void CoreRenderer::
+drawTrain(const TrackFrame& frame)
+//============================================================================
+{
+	const float halfSize = 3.0f;
+	const glm::vec3 up = frame.rotation * glm::vec3(0, 1, 0);
+	const glm::vec3 center = glm::vec3(frame.pos.x, frame.pos.y, frame.pos.z) + up * halfSize;
+	const glm::mat4 model = glm::translate(glm::mat4(1.0f), center)
+		* glm::mat4_cast(frame.rotation) * glm::scale(glm::mat4(1.0f), glm::vec3(halfSize));
+
+	CoreMaterial material;
+	material.specular = 0.6f;
+	material.shininess = 32.0f;
+	draw(train, model, material);
+}
+
+//****************************************************************************
+//
+// * The sleeper quads are uploaded again whenever the geometry changes
+//============================================================================
+void CoreRenderer::
+drawSleepers(const std::shared_ptr<const TrackGeometry>& geometry)
+//============================================================================
+{
+	if (geometry != sleepersFrom) {
+		sleepersFrom = geometry;
+		MeshData data;
+		if (geometry) {
+			const size_t quads = geometry->sleeperVertices.size() / 12;
+			data.vertices.resize(quads * 24);
+			data.indices.reserve(quads * 6);
+			for (size_t v = 0; v < quads * 4; ++v) {
+				for (int k = 0; k < 3; ++k) {
+					data.vertices[v * 6 + k] = geometry->sleeperVertices[v * 3 + k];
+					data.vertices[v * 6 + 3 + k] = geometry->sleeperNormals[v * 3 + k];
+				}
+			}
+			for (size_t q = 0; q < quads; ++q) {
+				const GLuint first = static_cast<GLuint>(q * 4);
+				data.indices.insert(data.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+			}
+		}
+		uploadMesh(sleepers, data);
+	}
+	if (sleepers.count > 0)
+		draw(sleepers, glm::mat4(1.0f), CoreMaterial());
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void CoreRenderer::
+drawRailChunk(GLuint vertices, GLuint indices, GLsizei count)
+//============================================================================
+{
+	CoreMaterial material;
+	material.color = glm::vec4(32, 32, 64, 255) / 255.0f;
+	drawBuffers(vertices, indices, count, glm::mat4(1.0f), material);
+}
+
+//****************************************************************************
+//
+// * In the shadow pass the model is squashed and the material replaced
+//============================================================================
+void CoreRenderer::
+setMaterial(const Program& program, const glm::mat4& model, const CoreMaterial& material)
+//============================================================================
+{
+	use(program);
+	if (shadowPass) {
+		const glm::mat4 squashed = shadowMatrix * model;
+		glUniformMatrix4fv(program.model, 1, GL_FALSE, glm::value_ptr(squashed));
+		glUniform4f(program.color, 0.0f, 0.0f, 0.0f, 0.5f);
+		glUniform1i(program.lit, 0);
+		return;
+	}
+
+	glUniformMatrix4fv(program.model, 1, GL_FALSE, glm::value_ptr(model));
+	if (program.normalMatrix != -1) {
+		const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(model));
+		glUniformMatrix3fv(program.normalMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+	}
+	glUniform4fv(program.color, 1, glm::value_ptr(material.color));
+	glUniform1i(program.lit, material.lit ? 1 : 0);
+	glUniform1f(program.specular, material.specular);
+	glUniform1f(program.shininess, material.shininess);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void CoreRenderer::
+draw(const CoreMesh& mesh, const glm::mat4& model, const CoreMaterial& material)
+//============================================================================
+{
+	setMaterial(meshProgram, model, material);
+	glBindVertexArray(mesh.vao);
+	// meshes without colors are white, the material colors them
+	if (!mesh.colors)
+		glVertexAttrib4f(2, 1.0f, 1.0f, 1.0f, 1.0f);
+	glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (GLvoid*)0);
+	glBindVertexArray(0);
+}
+
+//****************************************************************************
+//
+// * Buffers that belong to someone else - point the spare vertex array at
+//   them
+//============================================================================
+void CoreRenderer::
+drawBuffers(GLuint vertices, GLuint indices, GLsizei count,
+			const glm::mat4& model, const CoreMaterial& material)
+//============================================================================
+{
+	setMaterial(meshProgram, model, material);
+	glBindVertexArray(railVao);
+	glBindBuffer(GL_ARRAY_BUFFER, vertices);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	glVertexAttrib4f(2, 1.0f, 1.0f, 1.0f, 1.0f);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (GLvoid*)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
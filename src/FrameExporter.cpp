@@ -0,0 +1,206 @@
+/************************************************************************
+     File:        FrameExporter.cpp
+
+     Comment:     Offscreen frames to PNG files. See FrameExporter.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "FrameExporter.H"
+
+#include <cstdio>
+#include <cstring>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "RenderUtilities/GpuResources.h"
+#include "RenderUtilities/ReadbackBuffer.h"
+
+//****************************************************************************
+//
+// * A color and a depth/stencil renderbuffer - the view needs the stencil
+//   for its shadows
+//============================================================================
+FrameExporter::
+FrameExporter(int width, int height, const std::string& directory)
+	: width(width), height(height), directory(directory), complete(false),
+	  regionFrames(ReadbackBuffer::REGIONS, -1), captured(0), stopping(false), failed(0)
+//============================================================================
+{
+	glGenFramebuffers(1, &fbo);
+	glGenRenderbuffers(1, &color);
+	glGenRenderbuffers(1, &depthStencil);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GpuResources& gpu = GpuResources::instance();
+	const size_t pixels = static_cast<size_t>(width) * height;
+	gpu.created(GpuResources::FRAMEBUFFER, fbo, "FrameExporter");
+	gpu.created(GpuResources::RENDERBUFFER, color, "FrameExporter", pixels * 4);
+	gpu.created(GpuResources::RENDERBUFFER, depthStencil, "FrameExporter", pixels * 4);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+	complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// tightly packed BGR rows, the way cv::Mat wants them
+	readback.reset(new ReadbackBuffer(static_cast<GLsizeiptr>(width) * height * 3));
+	complete = complete && readback->valid();
+
+	writer = std::thread(&FrameExporter::write, this);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+FrameExporter::
+~FrameExporter()
+//============================================================================
+{
+	finish();
+	readback.reset();
+	GpuResources& gpu = GpuResources::instance();
+	gpu.deleted(GpuResources::FRAMEBUFFER, fbo);
+	gpu.deleted(GpuResources::RENDERBUFFER, color);
+	gpu.deleted(GpuResources::RENDERBUFFER, depthStencil);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &color);
+	glDeleteRenderbuffers(1, &depthStencil);
+}
+
+//****************************************************************************
+//
+// * The region about to be read into still holds a frame from
+//   REGIONS captures ago - queue that one first
+//============================================================================
+void FrameExporter::
+capture()
+//============================================================================
+{
+	if (!complete)
+		return;
+
+	const int region = readback->next();
+	if (regionFrames[region] >= 0)
+		collect(region);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	readback->read(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	regionFrames[region] = captured++;
+}
+
+//****************************************************************************
+//
+// * Copy a finished region out of the mapped buffer and hand it to the
+//   writer
+//============================================================================
+void FrameExporter::
+collect(int region)
+//============================================================================
+{
+	const unsigned char* pixels = static_cast<const unsigned char*>(readback->pixels(region));
+	const size_t size = static_cast<size_t>(readback->size());
+
+	Frame frame;
+	frame.number = regionFrames[region];
+	regionFrames[region] = -1;
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		wake.wait(guard, [this] { return queue.size() < MAX_QUEUED; });
+		if (!spare.empty()) {
+			frame.pixels = std::move(spare.back());
+			spare.pop_back();
+		}
+	}
+	frame.pixels.resize(size);
+	std::memcpy(frame.pixels.data(), pixels, size);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push_back(std::move(frame));
+	}
+	wake.notify_all();
+}
+
+//****************************************************************************
+//
+// * Collect the regions oldest first, so the files come out in order
+//============================================================================
+int FrameExporter::
+finish()
+//============================================================================
+{
+	if (!writer.joinable())
+		return failed;
+
+	for (int i = 0; i < ReadbackBuffer::REGIONS; ++i) {
+		const int region = (readback->next() + i) % ReadbackBuffer::REGIONS;
+		if (regionFrames[region] >= 0)
+			collect(region);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	writer.join();
+	return failed;
+}
+
+//****************************************************************************
+//
+// * The writer thread - GL reads the rows bottom up, so they are flipped
+//   on the way out
+//============================================================================
+void FrameExporter::
+write()
+//============================================================================
+{
+	const std::vector<int> options = { cv::IMWRITE_PNG_COMPRESSION, 1 };
+	cv::Mat flipped;
+	for (;;) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this] { return stopping || !queue.empty(); });
+			if (queue.empty())
+				return;
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+		wake.notify_all();
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "/frame_%05d.png", frame.number);
+		const cv::Mat image(height, width, CV_8UC3, frame.pixels.data());
+		cv::flip(image, flipped, 0);
+		bool written = false;
+		try {
+			written = cv::imwrite(directory + name, flipped, options);
+		}
+		catch (const cv::Exception&) {
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (!written) {
+			std::fprintf(stderr, "could not write %s%s\n", directory.c_str(), name);
+			++failed;
+		}
+		spare.push_back(std::move(frame.pixels));
+	}
+}
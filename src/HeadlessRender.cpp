@@ -0,0 +1,134 @@
+/************************************************************************
+     File:        HeadlessRender.cpp
+
+     Comment:     Rendering into files without a window. See
+						HeadlessRender.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "HeadlessRender.H"
+
+#include <cstdio>
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "FrameExporter.H"
+#include "TrainView.H"
+#include "TrainWindow.H"
+
+namespace {
+	// a compatibility profile context (the view still draws fixed
+	// function) current on this thread, with no surface to draw to
+	class HeadlessContext {
+		public:
+			HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE) {}
+			~HeadlessContext()
+			{
+				if (display == EGL_NO_DISPLAY)
+					return;
+				eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+				if (surface != EGL_NO_SURFACE)
+					eglDestroySurface(display, surface);
+				if (context != EGL_NO_CONTEXT)
+					eglDestroyContext(display, context);
+				eglTerminate(display);
+			}
+
+			// returns what went wrong, or null
+			const char* create()
+			{
+				PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+					reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+				if (getPlatformDisplay)
+					display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+				if (display == EGL_NO_DISPLAY)
+					display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+				EGLint major, minor;
+				if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+					return "no EGL display";
+				if (!eglBindAPI(EGL_OPENGL_API))
+					return "EGL can't make desktop GL contexts";
+
+				const EGLint configAttributes[] = {
+					EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+					EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+					EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+					EGL_NONE
+				};
+				EGLConfig config;
+				EGLint configs = 0;
+				if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs < 1)
+					return "no EGL config for desktop GL";
+
+				// 4.3 for the shaders
+				const EGLint contextAttributes[] = {
+					EGL_CONTEXT_MAJOR_VERSION, 4,
+					EGL_CONTEXT_MINOR_VERSION, 3,
+					EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+					EGL_NONE
+				};
+				context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+				if (context == EGL_NO_CONTEXT)
+					return "could not make a GL 4.3 compatibility context";
+
+				// everything is drawn into the exporter's framebuffer, so a
+				// surface is only made if the driver insists on one
+				if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+					const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+					surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+					if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context))
+						return "could not make the context current";
+				}
+
+				if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+					return "could not load GL";
+				return nullptr;
+			}
+
+		private:
+			EGLDisplay	display;
+			EGLContext	context;
+			EGLSurface	surface;
+	};
+}
+
+//****************************************************************************
+//
+// * The track is built before the first frame, so the film doesn't start
+//   with an empty world
+//============================================================================
+int
+renderHeadless(TrainWindow& tw, const char* directory, int frames)
+//============================================================================
+{
+	HeadlessContext context;
+	if (const char* error = context.create()) {
+		std::fprintf(stderr, "headless rendering: %s\n", error);
+		return 1;
+	}
+
+	TrainView& view = *tw.trainView;
+	FrameExporter exporter(view.w(), view.h(), directory);
+	if (!exporter.valid()) {
+		std::fprintf(stderr, "headless rendering: no offscreen framebuffer\n");
+		return 1;
+	}
+
+	view.waitForGeometry();
+	for (int i = 0; i < frames; ++i) {
+		glBindFramebuffer(GL_FRAMEBUFFER, exporter.framebuffer());
+		view.draw();
+		exporter.capture();
+		// not running, so every call is one 1/30 s step
+		tw.advanceTrain();
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	const int failed = exporter.finish();
+	std::printf("wrote %d frames to %s\n", frames - failed, directory);
+	return failed ? 1 : 0;
+}
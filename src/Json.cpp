@@ -0,0 +1,300 @@
+/************************************************************************
+     File:        Json.cpp
+
+     Comment:     A small JSON reader. See Json.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "Json.H"
+
+#include <charconv>
+#include <cstring>
+
+//****************************************************************************
+//
+// * A recursive descent over the text. every parse* leaves pos just past
+//   what it read, or sets error and returns false
+//============================================================================
+class JsonParser {
+	public:
+		JsonParser(const char* data, size_t size)
+			: pos(data), end(data + size), begin(data) {}
+
+		bool parseDocument(JsonValue& root);
+
+		std::string error;
+
+	private:
+		// a deeper nesting than this is taken to be a broken file
+		static const int MAX_DEPTH = 256;
+
+		bool parseValue(JsonValue& value, int depth);
+		bool parseString(std::string& text);
+		bool parseNumber(double& number);
+		bool parseLiteral(const char* word);
+		void skipSpace();
+		bool fail(const char* what);
+
+		const char*		pos;
+		const char*		end;
+		const char*		begin;
+};
+
+//****************************************************************************
+//
+// *
+//============================================================================
+const JsonValue* JsonValue::
+find(const char* key) const
+//============================================================================
+{
+	for (size_t i = 0; i < keys.size(); ++i)
+		if (keys[i] == key)
+			return &items[i];
+	return nullptr;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool
+parseJson(const char* data, size_t size, JsonValue& root, std::string& error)
+//============================================================================
+{
+	JsonParser parser(data, size);
+	if (parser.parseDocument(root))
+		return true;
+	root = JsonValue();
+	error = parser.error;
+	return false;
+}
+
+//****************************************************************************
+//
+// * One value and nothing after it
+//============================================================================
+bool JsonParser::
+parseDocument(JsonValue& root)
+//============================================================================
+{
+	if (!parseValue(root, 0))
+		return false;
+	skipSpace();
+	if (pos != end)
+		return fail("text after the end");
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool JsonParser::
+parseValue(JsonValue& value, int depth)
+//============================================================================
+{
+	if (depth > MAX_DEPTH)
+		return fail("nested too deeply");
+	skipSpace();
+	if (pos == end)
+		return fail("unexpected end");
+
+	switch (*pos) {
+		case '{': {
+			value.kind = JsonValue::JSON_OBJECT;
+			++pos;
+			skipSpace();
+			if (pos < end && *pos == '}') {
+				++pos;
+				return true;
+			}
+			for (;;) {
+				skipSpace();
+				std::string key;
+				if (pos == end || *pos != '"')
+					return fail("expected a key");
+				if (!parseString(key))
+					return false;
+				skipSpace();
+				if (pos == end || *pos != ':')
+					return fail("expected ':'");
+				++pos;
+				value.keys.push_back(std::move(key));
+				value.items.emplace_back();
+				if (!parseValue(value.items.back(), depth + 1))
+					return false;
+				skipSpace();
+				if (pos < end && *pos == ',') {
+					++pos;
+					continue;
+				}
+				if (pos < end && *pos == '}') {
+					++pos;
+					return true;
+				}
+				return fail("expected ',' or '}'");
+			}
+		}
+		case '[': {
+			value.kind = JsonValue::JSON_ARRAY;
+			++pos;
+			skipSpace();
+			if (pos < end && *pos == ']') {
+				++pos;
+				return true;
+			}
+			for (;;) {
+				value.items.emplace_back();
+				if (!parseValue(value.items.back(), depth + 1))
+					return false;
+				skipSpace();
+				if (pos < end && *pos == ',') {
+					++pos;
+					continue;
+				}
+				if (pos < end && *pos == ']') {
+					++pos;
+					return true;
+				}
+				return fail("expected ',' or ']'");
+			}
+		}
+		case '"':
+			value.kind = JsonValue::JSON_STRING;
+			return parseString(value.text);
+		case 't':
+			value.kind = JsonValue::JSON_BOOL;
+			value.flag = true;
+			return parseLiteral("true");
+		case 'f':
+			value.kind = JsonValue::JSON_BOOL;
+			value.flag = false;
+			return parseLiteral("false");
+		case 'n':
+			value.kind = JsonValue::JSON_NULL;
+			return parseLiteral("null");
+		default:
+			value.kind = JsonValue::JSON_NUMBER;
+			return parseNumber(value.value);
+	}
+}
+
+//****************************************************************************
+//
+// * pos is on the opening quote
+//============================================================================
+bool JsonParser::
+parseString(std::string& text)
+//============================================================================
+{
+	++pos;
+	while (pos < end && *pos != '"') {
+		const unsigned char c = static_cast<unsigned char>(*pos);
+		if (c < 0x20)
+			return fail("control character in a string");
+		if (c != '\\') {
+			text += *pos++;
+			continue;
+		}
+
+		if (++pos == end)
+			break;
+		switch (*pos++) {
+			case '"':	text += '"'; break;
+			case '\\':	text += '\\'; break;
+			case '/':	text += '/'; break;
+			case 'b':	text += '\b'; break;
+			case 'f':	text += '\f'; break;
+			case 'n':	text += '\n'; break;
+			case 'r':	text += '\r'; break;
+			case 't':	text += '\t'; break;
+			case 'u': {
+				unsigned code = 0;
+				if (end - pos < 4 || std::from_chars(pos, pos + 4, code, 16).ptr != pos + 4)
+					return fail("bad \\u escape");
+				pos += 4;
+				// surrogate pairs are left as two separate characters
+				if (code < 0x80)
+					text += static_cast<char>(code);
+				else if (code < 0x800) {
+					text += static_cast<char>(0xc0 | (code >> 6));
+					text += static_cast<char>(0x80 | (code & 0x3f));
+				}
+				else {
+					text += static_cast<char>(0xe0 | (code >> 12));
+					text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+					text += static_cast<char>(0x80 | (code & 0x3f));
+				}
+				break;
+			}
+			default:
+				return fail("bad escape");
+		}
+	}
+	if (pos == end)
+		return fail("unterminated string");
+	++pos;
+	return true;
+}
+
+//****************************************************************************
+//
+// * from_chars takes a little more than JSON does (leading zeros, "inf"),
+//   which is harmless here
+//============================================================================
+bool JsonParser::
+parseNumber(double& number)
+//============================================================================
+{
+	const std::from_chars_result result = std::from_chars(pos, end, number);
+	if (result.ec != std::errc() || result.ptr == pos)
+		return fail("expected a value");
+	pos = result.ptr;
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool JsonParser::
+parseLiteral(const char* word)
+//============================================================================
+{
+	const size_t length = std::strlen(word);
+	if (static_cast<size_t>(end - pos) < length || std::strncmp(pos, word, length) != 0)
+		return fail("expected a value");
+	pos += length;
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void JsonParser::
+skipSpace()
+//============================================================================
+{
+	while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+		++pos;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool JsonParser::
+fail(const char* what)
+//============================================================================
+{
+	int line = 1;
+	for (const char* c = begin; c < pos; ++c)
+		if (*c == '\n')
+			++line;
+	error = std::string(what) + " on line " + std::to_string(line);
+	return false;
+}
@@ -0,0 +1,361 @@
+/************************************************************************
+     File:        OceanFFT.cpp
+
+     Comment:     CPU ocean surface built from a statistical wave spectrum.
+						See OceanFFT.H for the overview and texel layout.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "OceanFFT.H"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "Utilities/ThreadPool.H"
+
+namespace {
+	const float kPi = 3.14159265359f;
+	const float kGravity = 9.81f;
+
+	int log2Of(int n)
+	{
+		int l = 0;
+		while ((1 << l) < n)
+			++l;
+		return l;
+	}
+}
+
+//****************************************************************************
+//
+// * Constructors
+//============================================================================
+OceanFFT::
+OceanFFT()
+	: log2N(0)
+//============================================================================
+{
+	reset(Settings());
+}
+
+OceanFFT::
+OceanFFT(const Settings& s)
+	: log2N(0)
+//============================================================================
+{
+	reset(s);
+}
+
+//****************************************************************************
+//
+// * Sample the spectrum into h0(k) and set up the FFT tables
+//============================================================================
+void OceanFFT::
+reset(const Settings& s)
+//============================================================================
+{
+	settings = s;
+
+	// the transform only handles powers of two in the supported range
+	int n = std::min(512, std::max(128, settings.resolution));
+	log2N = log2Of(n);
+	n = 1 << log2N;
+	settings.resolution = n;
+
+	const size_t count = static_cast<size_t>(n) * static_cast<size_t>(n);
+	h0.assign(count, Complex(0.0f, 0.0f));
+	h0MinusConj.assign(count, Complex(0.0f, 0.0f));
+	omega.assign(count, 0.0f);
+	for (int g = 0; g < 3; ++g) {
+		grids[g].assign(count, Complex(0.0f, 0.0f));
+		scratch[g].assign(count, Complex(0.0f, 0.0f));
+	}
+
+	bitReverse.resize(n);
+	for (int i = 0; i < n; ++i) {
+		unsigned r = 0;
+		for (int b = 0; b < log2N; ++b)
+			if (i & (1 << b))
+				r |= 1u << (log2N - 1 - b);
+		bitReverse[i] = r;
+	}
+
+	twiddles.resize(n / 2);
+	for (int j = 0; j < n / 2; ++j) {
+		const float a = 2.0f * kPi * static_cast<float>(j) / static_cast<float>(n);
+		twiddles[j] = Complex(std::cos(a), std::sin(a));
+	}
+
+	// the random draw is done serially so a seed always gives the same sea
+	std::mt19937 rng(settings.seed);
+	std::normal_distribution<float> gauss(0.0f, 1.0f);
+	const float dk = 2.0f * kPi / settings.patchSize;
+	for (int m = 0; m < n; ++m) {
+		for (int i = 0; i < n; ++i) {
+			const float kx = dk * static_cast<float>(i - n / 2);
+			const float kz = dk * static_cast<float>(m - n / 2);
+			const float amp = std::sqrt(std::max(0.0f, spectrumAt(kx, kz))) * 0.70710678f;
+			const size_t idx = static_cast<size_t>(m) * n + i;
+			h0[idx] = Complex(gauss(rng) * amp, gauss(rng) * amp);
+			omega[idx] = std::sqrt(kGravity * std::sqrt(kx * kx + kz * kz));
+		}
+	}
+
+	// -k lives at (n - i, n - m), wrapped
+	for (int m = 0; m < n; ++m) {
+		for (int i = 0; i < n; ++i) {
+			const size_t mirror = static_cast<size_t>((n - m) % n) * n + static_cast<size_t>((n - i) % n);
+			h0MinusConj[static_cast<size_t>(m) * n + i] = std::conj(h0[mirror]);
+		}
+	}
+}
+
+//****************************************************************************
+//
+// * Energy of the wave vector (kx, kz), already multiplied by dk^2 so
+//   h0 = (xi_r + i xi_i) * sqrt(spectrum / 2)
+//============================================================================
+float OceanFFT::
+spectrumAt(float kx, float kz) const
+//============================================================================
+{
+	const float k2 = kx * kx + kz * kz;
+	if (k2 < 1e-12f)
+		return 0.0f;
+	const float k = std::sqrt(k2);
+
+	float wx = settings.windDirX;
+	float wz = settings.windDirZ;
+	const float wl = std::sqrt(wx * wx + wz * wz);
+	if (wl > 1e-6f) {
+		wx /= wl;
+		wz /= wl;
+	} else {
+		wx = 1.0f;
+		wz = 0.0f;
+	}
+	const float cosTheta = (kx * wx + kz * wz) / k;
+	const float dk = 2.0f * kPi / settings.patchSize;
+	const float V = std::max(0.1f, settings.windSpeed);
+
+	if (settings.spectrum == JONSWAP) {
+		// spectrum in terms of omega, then moved over to the wave vector
+		if (cosTheta <= 0.0f)
+			return 0.0f;
+		const float w = std::sqrt(kGravity * k);
+		const float F = std::max(1.0f, settings.fetch);
+		const float alpha = 0.076f * std::pow(V * V / (F * kGravity), 0.22f);
+		const float wp = 22.0f * std::pow(kGravity * kGravity / (V * F), 1.0f / 3.0f);
+		const float sigma = (w <= wp) ? 0.07f : 0.09f;
+		const float r = std::exp(-(w - wp) * (w - wp) / (2.0f * sigma * sigma * wp * wp));
+		const float sw = alpha * kGravity * kGravity / std::pow(w, 5.0f)
+			* std::exp(-1.25f * std::pow(wp / w, 4.0f))
+			* std::pow(settings.peakGamma, r);
+		const float spread = (2.0f / kPi) * cosTheta * cosTheta;
+		const float dwdk = kGravity / (2.0f * w);
+		return settings.amplitude * 2.0f * sw * spread * dwdk / k * dk * dk;
+	}
+
+	// Phillips
+	const float L = V * V / kGravity;
+	const float l = L * 0.001f;		// damp the tiny waves
+	float directional = cosTheta * cosTheta;
+	if (cosTheta < 0.0f)
+		directional *= 0.07f;		// waves moving against the wind are weak
+	// 2e-3 puts the rms height in the right range for a fully developed
+	// sea (about 1.7m at 18 m/s)
+	const float phillips = 2e-3f * std::exp(-1.0f / (k2 * L * L)) / (k2 * k2)
+		* directional * std::exp(-k2 * l * l);
+	return settings.amplitude * phillips * dk * dk;
+}
+
+//****************************************************************************
+//
+// * Evolve h0 to time t, build the packed spectra and transform them
+//============================================================================
+void OceanFFT::
+update(float time)
+//============================================================================
+{
+	const int n = settings.resolution;
+	const float dk = 2.0f * kPi / settings.patchSize;
+
+	ThreadPool::instance().parallelFor(0, static_cast<size_t>(n), 0,
+		[&](size_t rowBegin, size_t rowEnd) {
+			for (size_t m = rowBegin; m < rowEnd; ++m) {
+				const float kz = dk * static_cast<float>(static_cast<int>(m) - n / 2);
+				for (int i = 0; i < n; ++i) {
+					const size_t idx = m * n + i;
+					const float kx = dk * static_cast<float>(i - n / 2);
+					const float k = std::sqrt(kx * kx + kz * kz);
+
+					const float wt = omega[idx] * time;
+					const Complex e(std::cos(wt), std::sin(wt));
+					const Complex h = h0[idx] * e + h0MinusConj[idx] * std::conj(e);
+
+					Complex dx(0.0f, 0.0f), dz(0.0f, 0.0f);
+					Complex dxx(0.0f, 0.0f), dzz(0.0f, 0.0f), dxz(0.0f, 0.0f);
+					if (k > 1e-6f) {
+						const float invK = 1.0f / k;
+						// -i k/|k| h
+						dx = Complex(h.imag() * kx * invK, -h.real() * kx * invK);
+						dz = Complex(h.imag() * kz * invK, -h.real() * kz * invK);
+						// derivatives of the displacement: k k / |k| h
+						dxx = h * (kx * kx * invK);
+						dzz = h * (kz * kz * invK);
+						dxz = h * (kx * kz * invK);
+					}
+
+					const Complex I(0.0f, 1.0f);
+					grids[0][idx] = h + I * dx;
+					grids[1][idx] = dz + I * dxx;
+					grids[2][idx] = dzz + I * dxz;
+				}
+			}
+		});
+
+	inverse2D();
+}
+
+//****************************************************************************
+//
+// * rows, transpose, rows, transpose - so the grids end up the right way round
+//============================================================================
+void OceanFFT::
+inverse2D()
+//============================================================================
+{
+	inverseRows();
+	transposeAll();
+	inverseRows();
+	transposeAll();
+}
+
+//****************************************************************************
+//
+// * Every row of all three grids, spread across the pool
+//============================================================================
+void OceanFFT::
+inverseRows()
+//============================================================================
+{
+	const size_t n = static_cast<size_t>(settings.resolution);
+	ThreadPool::instance().parallelFor(0, 3 * n, 0,
+		[&](size_t rowBegin, size_t rowEnd) {
+			for (size_t r = rowBegin; r < rowEnd; ++r)
+				inverse1D(&grids[r / n][(r % n) * n]);
+		});
+}
+
+//****************************************************************************
+//
+// * Transpose every grid through its scratch buffer, split by row
+//============================================================================
+void OceanFFT::
+transposeAll()
+//============================================================================
+{
+	const size_t n = static_cast<size_t>(settings.resolution);
+	ThreadPool::instance().parallelFor(0, 3 * n, 0,
+		[&](size_t rowBegin, size_t rowEnd) {
+			for (size_t r = rowBegin; r < rowEnd; ++r) {
+				const std::vector<Complex>& src = grids[r / n];
+				std::vector<Complex>& dst = scratch[r / n];
+				const size_t row = r % n;
+				for (size_t c = 0; c < n; ++c)
+					dst[row * n + c] = src[c * n + row];
+			}
+		});
+	for (int g = 0; g < 3; ++g)
+		grids[g].swap(scratch[g]);
+}
+
+//****************************************************************************
+//
+// * In-place radix-2 inverse FFT of one row (no 1/N - the spectrum
+//   amplitudes already are the real wave amplitudes)
+//============================================================================
+void OceanFFT::
+inverse1D(Complex* data) const
+//============================================================================
+{
+	const int n = settings.resolution;
+	for (int i = 0; i < n; ++i) {
+		const int j = static_cast<int>(bitReverse[i]);
+		if (j > i)
+			std::swap(data[i], data[j]);
+	}
+
+	for (int len = 2; len <= n; len <<= 1) {
+		const int half = len >> 1;
+		const int step = n / len;
+		for (int start = 0; start < n; start += len) {
+			for (int j = 0; j < half; ++j) {
+				const Complex w = twiddles[j * step];
+				const Complex a = data[start + j];
+				const Complex b = data[start + j + half] * w;
+				data[start + j] = a + b;
+				data[start + j + half] = a - b;
+			}
+		}
+	}
+}
+
+//****************************************************************************
+//
+// * Unpack the transforms into RGBA texels
+//   the spectrum was centered on k = 0, which leaves a (-1)^(x+z) factor
+//   on every output sample
+//============================================================================
+void OceanFFT::
+writeTexels(float* rgba) const
+//============================================================================
+{
+	const int n = settings.resolution;
+	const float lambda = settings.choppiness;
+	const float heightScale = settings.heightScale;
+
+	ThreadPool::instance().parallelFor(0, static_cast<size_t>(n), 0,
+		[&](size_t rowBegin, size_t rowEnd) {
+			for (size_t m = rowBegin; m < rowEnd; ++m) {
+				for (int i = 0; i < n; ++i) {
+					const size_t idx = m * n + i;
+					const float sign = ((static_cast<int>(m) + i) & 1) ? -1.0f : 1.0f;
+					const float height = grids[0][idx].real() * sign;
+					const float dx = grids[0][idx].imag() * sign;
+					const float dz = grids[1][idx].real() * sign;
+					const float dxx = grids[1][idx].imag() * sign;
+					const float dzz = grids[2][idx].real() * sign;
+					const float dxz = grids[2][idx].imag() * sign;
+
+					const float jacobian = (1.0f + lambda * dxx) * (1.0f + lambda * dzz)
+						- (lambda * dxz) * (lambda * dxz);
+
+					float* texel = rgba + idx * 4;
+					texel[0] = 0.5f + height * heightScale;
+					texel[1] = lambda * dx;
+					texel[2] = lambda * dz;
+					texel[3] = jacobian;
+				}
+			}
+		});
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+size_t OceanFFT::
+memoryUsed() const
+//============================================================================
+{
+	size_t bytes = (h0.capacity() + h0MinusConj.capacity() + twiddles.capacity()) * sizeof(Complex);
+	bytes += omega.capacity() * sizeof(float);
+	bytes += bitReverse.capacity() * sizeof(unsigned);
+	for (int i = 0; i < 3; ++i)
+		bytes += (grids[i].capacity() + scratch[i].capacity()) * sizeof(Complex);
+	return bytes;
+}
@@ -0,0 +1,179 @@
+/************************************************************************
+     File:        RailMesh.cpp
+
+     Comment:     Rail profiles and the sweep that turns them into
+						triangles. See RailMesh.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "RailMesh.H"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const float kPi = 3.14159265359f;
+	const float kRailOffset = 2.5f;		// matches the old line rails
+
+	// how far a ring may move before its chunk is remeshed - far below
+	// anything visible, far above float noise
+	const float kRingTolerance = 1e-3f;
+	const float kFrameTolerance = 5e-7f;	// 1 - |cos| of half the angle
+
+	// a closed polygon, counter-clockwise, flat shaded
+	void addPolygon(std::vector<RailProfileEdge>& edges, const glm::vec2* points, size_t count, const glm::vec2& offset)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			const glm::vec2 p0 = points[i] + offset;
+			const glm::vec2 p1 = points[(i + 1) % count] + offset;
+			const glm::vec2 d = p1 - p0;
+			const glm::vec2 n = glm::normalize(glm::vec2(d.y, -d.x));
+			edges.push_back(RailProfileEdge{ p0, p1, n, n });
+		}
+	}
+
+	// a circle, smooth shaded
+	void addCircle(std::vector<RailProfileEdge>& edges, const glm::vec2& center, float radius, int sides)
+	{
+		for (int i = 0; i < sides; ++i) {
+			const float a0 = 2.0f * kPi * i / sides;
+			const float a1 = 2.0f * kPi * (i + 1) / sides;
+			const glm::vec2 n0(std::cos(a0), std::sin(a0));
+			const glm::vec2 n1(std::cos(a1), std::sin(a1));
+			edges.push_back(RailProfileEdge{ center + n0 * radius, center + n1 * radius, n0, n1 });
+		}
+	}
+
+	std::vector<RailProfileEdge> makeIBeam()
+	{
+		// foot, web and head of a flat-bottom rail standing on the sleepers
+		const glm::vec2 outline[] = {
+			{ -0.35f, 0.00f }, { 0.35f, 0.00f }, { 0.35f, 0.12f }, { 0.08f, 0.12f },
+			{ 0.08f, 0.62f }, { 0.20f, 0.62f }, { 0.20f, 0.82f }, { -0.20f, 0.82f },
+			{ -0.20f, 0.62f }, { -0.08f, 0.62f }, { -0.08f, 0.12f }, { -0.35f, 0.12f }
+		};
+		const size_t count = sizeof(outline) / sizeof(outline[0]);
+		std::vector<RailProfileEdge> edges;
+		addPolygon(edges, outline, count, glm::vec2(-kRailOffset, 0.05f));
+		addPolygon(edges, outline, count, glm::vec2(kRailOffset, 0.05f));
+		return edges;
+	}
+
+	std::vector<RailProfileEdge> makeTube()
+	{
+		std::vector<RailProfileEdge> edges;
+		addCircle(edges, glm::vec2(-kRailOffset, 0.35f), 0.3f, 8);
+		addCircle(edges, glm::vec2(kRailOffset, 0.35f), 0.3f, 8);
+		return edges;
+	}
+
+	std::vector<RailProfileEdge> makeBoxSpine()
+	{
+		const glm::vec2 box[] = {
+			{ -0.9f, -2.0f }, { 0.9f, -2.0f }, { 0.9f, -0.6f }, { -0.9f, -0.6f }
+		};
+		std::vector<RailProfileEdge> edges = makeTube();
+		addPolygon(edges, box, 4, glm::vec2(0.0f, 0.0f));
+		return edges;
+	}
+
+}
+
+//****************************************************************************
+//
+// * The profiles are only built once
+//============================================================================
+const std::vector<RailProfileEdge>& railProfileEdges(int profile)
+//============================================================================
+{
+	static const std::vector<RailProfileEdge> ibeam = makeIBeam();
+	static const std::vector<RailProfileEdge> tube = makeTube();
+	static const std::vector<RailProfileEdge> spine = makeBoxSpine();
+	switch (profile) {
+		case RAIL_TUBE:			return tube;
+		case RAIL_BOX_SPINE:	return spine;
+		default:				return ibeam;
+	}
+}
+
+//****************************************************************************
+//
+// * q and -q are the same rotation, hence the abs
+//============================================================================
+bool railChunkSweptAlong(const RailChunk& chunk, int profile,
+						 const std::vector<glm::vec3>& ringPositions,
+						 const std::vector<glm::quat>& ringFrames)
+//============================================================================
+{
+	if (chunk.profile != profile || chunk.ringPositions.size() != ringPositions.size())
+		return false;
+	for (size_t r = 0; r < ringPositions.size(); ++r) {
+		const glm::vec3 d = glm::abs(chunk.ringPositions[r] - ringPositions[r]);
+		if (d.x > kRingTolerance || d.y > kRingTolerance || d.z > kRingTolerance)
+			return false;
+		if (1.0f - std::fabs(glm::dot(chunk.ringFrames[r], ringFrames[r])) > kFrameTolerance)
+			return false;
+	}
+	return true;
+}
+
+//****************************************************************************
+//
+// * Two vertices per edge per ring, and two triangles per edge between
+//   every pair of rings
+//============================================================================
+void sweepRailProfile(RailChunk& chunk, int profileChoice,
+					  const std::vector<glm::vec3>& ringPositions,
+					  const std::vector<glm::quat>& ringFrames)
+//============================================================================
+{
+	const std::vector<RailProfileEdge>& profile = railProfileEdges(profileChoice);
+	chunk.profile = profileChoice;
+	chunk.ringPositions = ringPositions;
+	chunk.ringFrames = ringFrames;
+
+	const size_t rings = ringPositions.size();
+	const size_t ringVertices = profile.size() * 2;
+	chunk.vertices.resize(rings * ringVertices * 6);
+	chunk.indices.clear();
+	chunk.boundsMin = glm::vec3(1e30f);
+	chunk.boundsMax = glm::vec3(-1e30f);
+	if (rings < 2)
+		return;
+	chunk.indices.reserve((rings - 1) * profile.size() * 6);
+
+	float* out = chunk.vertices.data();
+	for (size_t r = 0; r < rings; ++r) {
+		const glm::mat3 basis = glm::mat3_cast(ringFrames[r]);
+		const glm::vec3& center = ringPositions[r];
+		for (const RailProfileEdge& edge : profile) {
+			const glm::vec2* points[2] = { &edge.p0, &edge.p1 };
+			const glm::vec2* normals[2] = { &edge.n0, &edge.n1 };
+			for (int end = 0; end < 2; ++end) {
+				const glm::vec3 p = center + basis[0] * points[end]->x + basis[1] * points[end]->y;
+				const glm::vec3 n = basis[0] * normals[end]->x + basis[1] * normals[end]->y;
+				chunk.boundsMin = glm::min(chunk.boundsMin, p);
+				chunk.boundsMax = glm::max(chunk.boundsMax, p);
+				*out++ = p.x; *out++ = p.y; *out++ = p.z;
+				*out++ = n.x; *out++ = n.y; *out++ = n.z;
+			}
+		}
+	}
+
+	for (size_t r = 0; r + 1 < rings; ++r) {
+		const unsigned ring0 = static_cast<unsigned>(r * ringVertices);
+		const unsigned ring1 = static_cast<unsigned>((r + 1) * ringVertices);
+		for (unsigned e = 0; e < profile.size(); ++e) {
+			const unsigned a = ring0 + e * 2;
+			const unsigned c = ring1 + e * 2;
+			chunk.indices.push_back(a);
+			chunk.indices.push_back(c);
+			chunk.indices.push_back(a + 1);
+			chunk.indices.push_back(a + 1);
+			chunk.indices.push_back(c);
+			chunk.indices.push_back(c + 1);
+		}
+	}
+}
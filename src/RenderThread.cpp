@@ -0,0 +1,155 @@
+/************************************************************************
+     File:        RenderThread.cpp
+
+     Comment:     The TrainView's drawing thread. See RenderThread.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "RenderThread.H"
+
+#include <cstdio>
+
+#include "TrainView.H"
+
+#pragma warning(push)
+#pragma warning(disable:4312)
+#pragma warning(disable:4311)
+#include <Fl/x.H>
+#pragma warning(pop)
+
+#ifndef _WIN32
+#	include <GL/glx.h>
+#endif
+
+namespace {
+	// make the view's context current on this thread. this goes round
+	// Fl_Gl_Window::make_current on purpose: FLTK remembers the last
+	// context it made current, not which thread it did it on, and would
+	// skip the call
+	void makeCurrent(TrainView& view)
+	{
+#ifdef _WIN32
+		wglMakeCurrent(Fl_X::i(&view)->private_dc, static_cast<HGLRC>(view.context()));
+#else
+		glXMakeCurrent(fl_display, fl_xid(&view), static_cast<GLXContext>(view.context()));
+#endif
+	}
+
+	void releaseCurrent()
+	{
+#ifdef _WIN32
+		wglMakeCurrent(NULL, NULL);
+#else
+		glXMakeCurrent(fl_display, None, NULL);
+#endif
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+RenderThread::
+RenderThread(TrainView& view)
+	: view(view), stopping(false), drawn(0), dropped(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+RenderThread::
+~RenderThread()
+//============================================================================
+{
+	stop();
+}
+
+//****************************************************************************
+//
+// * make_current first, so the context is there (FLTK makes it the first
+//   time), then let go of it for the render thread to take
+//============================================================================
+void RenderThread::
+start()
+//============================================================================
+{
+	if (running())
+		return;
+	view.make_current();
+	releaseCurrent();
+
+	stopping = false;
+	thread = std::thread(&RenderThread::run, this);
+}
+
+//****************************************************************************
+//
+// * The frame being drawn is finished, one still waiting is not. the
+//   context comes back to this thread, where FLTK thinks it still is
+//============================================================================
+void RenderThread::
+stop()
+//============================================================================
+{
+	if (!running())
+		return;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		stopping = true;
+		pending.reset();
+	}
+	wake.notify_one();
+	thread.join();
+	makeCurrent(view);
+
+	printf("render thread: %llu frames drawn, %llu dropped\n",
+		   drawn.load(), dropped.load());
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void RenderThread::
+post(std::shared_ptr<const FramePacket> packet)
+//============================================================================
+{
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		if (pending)
+			++dropped;
+		pending = std::move(packet);
+	}
+	wake.notify_one();
+}
+
+//****************************************************************************
+//
+// * Wait for a packet, draw it, show it - the mutex is only held to take
+//   the packet, never while drawing
+//============================================================================
+void RenderThread::
+run()
+//============================================================================
+{
+	makeCurrent(view);
+	for (;;) {
+		std::shared_ptr<const FramePacket> packet;
+		{
+			std::unique_lock<std::mutex> guard(mutex);
+			wake.wait(guard, [this] { return stopping || pending; });
+			if (stopping)
+				break;
+			packet.swap(pending);
+		}
+		view.render(*packet);
+		view.swap_buffers();
+		++drawn;
+	}
+	releaseCurrent();
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include <glad\glad.h>
 
+#include "GpuResources.h"
+
 #define MAX_FBO_TEXTURE_AMOUNT 4
 #define MAX_VAO_VBO_AMOUNT 4
 
@@ -25,4 +27,37 @@ struct FBO
 	GLuint fbo;	//frame buffer
 	GLuint textures[MAX_FBO_TEXTURE_AMOUNT];	//attach to color buffer
 	GLuint rbo;	//attach to depth and stencil
-};
\ No newline at end of file
+};
+
+// glGenBuffers / glGenVertexArrays and the deletes, counted in
+// GpuResources under owner
+inline void genBuffers(GLsizei n, GLuint* names, const char* owner)
+{
+	glGenBuffers(n, names);
+	for (GLsizei i = 0; i < n; ++i)
+		GpuResources::instance().created(GpuResources::BUFFER, names[i], owner);
+}
+inline void deleteBuffers(GLsizei n, const GLuint* names)
+{
+	for (GLsizei i = 0; i < n; ++i)
+		GpuResources::instance().deleted(GpuResources::BUFFER, names[i]);
+	glDeleteBuffers(n, names);
+}
+inline void genVertexArrays(GLsizei n, GLuint* names, const char* owner)
+{
+	glGenVertexArrays(n, names);
+	for (GLsizei i = 0; i < n; ++i)
+		GpuResources::instance().created(GpuResources::VERTEX_ARRAY, names[i], owner);
+}
+inline void deleteVertexArrays(GLsizei n, const GLuint* names)
+{
+	for (GLsizei i = 0; i < n; ++i)
+		GpuResources::instance().deleted(GpuResources::VERTEX_ARRAY, names[i]);
+	glDeleteVertexArrays(n, names);
+}
+// glBufferData on buffer, which must be the one bound to target
+inline void bufferData(GLenum target, GLuint buffer, GLsizeiptr size, const void* data, GLenum usage)
+{
+	glBufferData(target, size, data, usage);
+	GpuResources::instance().resized(GpuResources::BUFFER, buffer, static_cast<size_t>(size));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// The six planes of a view volume, pulled out of projection * view
+// (Gribb & Hartmann). Used to skip whole chunks of geometry that are
+// off screen.
+//
+//		Frustum frustum(projection * view);
+//		if (frustum.intersects(chunk.boundsMin, chunk.boundsMax)) ... draw it
+class Frustum
+{
+public:
+	Frustum() {}
+	explicit Frustum(const glm::mat4& clip) { set(clip); }
+
+	void set(const glm::mat4& clip)
+	{
+		const glm::vec4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+		const glm::vec4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+		const glm::vec4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+		const glm::vec4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+		this->planes[0] = row3 + row0;	// left
+		this->planes[1] = row3 - row0;	// right
+		this->planes[2] = row3 + row1;	// bottom
+		this->planes[3] = row3 - row1;	// top
+		this->planes[4] = row3 + row2;	// near
+		this->planes[5] = row3 - row2;	// far
+	}
+
+	// false only if the box is completely outside one of the planes
+	bool intersects(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+	{
+		for (int i = 0; i < 6; ++i) {
+			const glm::vec4& p = this->planes[i];
+			// the corner furthest along the plane normal
+			const glm::vec3 corner(p.x >= 0.0f ? boxMax.x : boxMin.x,
+								   p.y >= 0.0f ? boxMax.y : boxMin.y,
+								   p.z >= 0.0f ? boxMax.z : boxMin.z);
+			if (p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0.0f)
+				return false;
+		}
+		return true;
+	}
+private:
+	glm::vec4 planes[6];
+};
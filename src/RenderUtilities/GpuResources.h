@@ -0,0 +1,148 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+
+// Keeps count of the GL objects the program has alive, and roughly how
+// many bytes each one holds on the GPU. Every object made through the
+// wrappers (BufferObject.h, Texture.h, Shader.h, PixelBuffer.h,
+// ReadbackBuffer.h) is entered with an owner - a short name for whatever
+// made it - and taken out again when it is deleted, so an object that is
+// made every frame and never deleted shows up as a count that keeps going
+// up between two frames.
+//
+//		GpuResources& gpu = GpuResources::instance();
+//		gpu.created(GpuResources::TEXTURE, id, "images/wave.png", bytes);
+//		...
+//		gpu.deleted(GpuResources::TEXTURE, id);
+//
+// The sizes are what the objects were given (glBufferData, glTexStorage2D
+// and the like), not what the driver really spent on them. Only the thread
+// with the GL context may use it.
+class GpuResources
+{
+public:
+	enum Kind {
+		BUFFER,
+		TEXTURE,
+		VERTEX_ARRAY,
+		PROGRAM,
+		FRAMEBUFFER,
+		RENDERBUFFER,
+		KIND_COUNT
+	};
+
+	struct Totals {
+		size_t count[KIND_COUNT] = {};
+		size_t bytes[KIND_COUNT] = {};
+		size_t created = 0;		// ever, of any kind
+		size_t deleted = 0;
+	};
+
+	static GpuResources& instance()
+	{
+		static GpuResources resources;
+		return resources;
+	}
+
+	static const char* kindName(Kind kind)
+	{
+		static const char* names[KIND_COUNT] = {
+			"buffers", "textures", "vertex arrays", "programs", "framebuffers", "renderbuffers"
+		};
+		return names[kind];
+	}
+
+	void created(Kind kind, GLuint name, const std::string& owner, size_t bytes = 0)
+	{
+		if (name == 0)
+			return;
+		Entry& entry = this->live[Key(kind, name)];
+		if (!entry.owner.empty())
+			this->forget(kind, entry);
+		entry.owner = owner;
+		entry.bytes = bytes;
+		++this->sums.count[kind];
+		this->sums.bytes[kind] += bytes;
+		++this->sums.created;
+	}
+	// the object got new storage (glBufferData again, say)
+	void resized(Kind kind, GLuint name, size_t bytes)
+	{
+		auto found = this->live.find(Key(kind, name));
+		if (found == this->live.end())
+			return;
+		this->sums.bytes[kind] -= found->second.bytes;
+		this->sums.bytes[kind] += bytes;
+		found->second.bytes = bytes;
+	}
+	void deleted(Kind kind, GLuint name)
+	{
+		auto found = this->live.find(Key(kind, name));
+		if (found == this->live.end())
+			return;
+		this->forget(kind, found->second);
+		++this->sums.deleted;
+		this->live.erase(found);
+	}
+
+	const Totals& totals() const { return this->sums; }
+
+	size_t totalBytes() const
+	{
+		size_t bytes = 0;
+		for (int k = 0; k < KIND_COUNT; ++k)
+			bytes += this->sums.bytes[k];
+		return bytes;
+	}
+
+	// every live object, owner by owner
+	void report(FILE* out) const
+	{
+		struct Group {
+			size_t count[KIND_COUNT] = {};
+			size_t bytes = 0;
+		};
+		std::map<std::string, Group> owners;
+		for (const auto& object : this->live) {
+			Group& group = owners[object.second.owner];
+			++group.count[object.first.first];
+			group.bytes += object.second.bytes;
+		}
+
+		fprintf(out, "GPU objects: %zu alive, %zu made, %zu deleted, %.1f KB\n",
+				this->live.size(), this->sums.created, this->sums.deleted, this->totalBytes() / 1024.0);
+		for (int k = 0; k < KIND_COUNT; ++k)
+			fprintf(out, "  %-14s %6zu  %10.1f KB\n", kindName(static_cast<Kind>(k)),
+					this->sums.count[k], this->sums.bytes[k] / 1024.0);
+		fprintf(out, "by owner:\n");
+		for (const auto& owner : owners) {
+			fprintf(out, "  %-28s %10.1f KB ", owner.first.c_str(), owner.second.bytes / 1024.0);
+			for (int k = 0; k < KIND_COUNT; ++k)
+				if (owner.second.count[k])
+					fprintf(out, " %zu %s", owner.second.count[k], kindName(static_cast<Kind>(k)));
+			fprintf(out, "\n");
+		}
+	}
+
+private:
+	typedef std::pair<Kind, GLuint> Key;
+	struct Entry {
+		std::string owner;
+		size_t bytes = 0;
+	};
+
+	GpuResources() {}
+
+	void forget(Kind kind, const Entry& entry)
+	{
+		--this->sums.count[kind];
+		this->sums.bytes[kind] -= entry.bytes;
+	}
+
+	std::map<Key, Entry> live;
+	Totals sums;
+};
@@ -0,0 +1,351 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "BufferObject.h"
+#include "../Utilities/FrameArena.H"
+
+// glBegin/glEnd without the per vertex calls into the driver. begin,
+// vertex, normal, color and end work like their gl* namesakes, but the
+// vertices only go into an arena; flush() uploads everything since the
+// last flush into one buffer and draws it with one glDrawArrays per
+// bucket (triangles, lines or points - quads, strips, fans and polygons
+// are turned into triangles - with or without their own colors).
+//
+//		ImmediateBatch& imm = ImmediateBatch::instance();
+//		imm.begin(GL_QUADS);
+//		imm.color3f(1, 0, 0);
+//		imm.normal3f(0, 1, 0);
+//		imm.vertex3f(...);
+//		...
+//		imm.end();
+//		imm.flush();
+//
+// GL's modelview and projection apply at the flush, so nothing that moves
+// them (glPushMatrix, setupShadows) may come between the vertices and the
+// flush - pushMatrix, translate, rotate and scale here do the same job on
+// the vertices as they come in. The same goes for any other GL state: the
+// batch is drawn with whatever is set at the flush.
+//
+// Colors are sticky, as in GL. vertices drawn before any color() since the
+// last flush take GL's current color at the flush (the shadow pass sets it
+// that way); after a flush GL's current color is the last one given here.
+// Flat shading takes its color from a different vertex of a quad, and the
+// buckets are drawn in their own order, not the order things were given -
+// fine for depth tested solids, not for blending that needs an order.
+//
+// Defer lets a caller that draws a lot of little things (each flushing at
+// its end) make one flush of them all.
+//
+// One batch for the thread that has the GL context - it is never deleted,
+// since the context is gone by the time statics are.
+class ImmediateBatch
+{
+public:
+	// past this many vertices end() flushes by itself
+	static const size_t MAX_VERTICES = 1 << 16;
+
+	static ImmediateBatch& instance()
+	{
+		static ImmediateBatch* batch = new ImmediateBatch();
+		return *batch;
+	}
+
+	// flushes in between are put off to the end of the outermost Defer
+	class Defer
+	{
+	public:
+		Defer() : batch(ImmediateBatch::instance()) { ++this->batch.deferred; }
+		~Defer()
+		{
+			if (--this->batch.deferred == 0)
+				this->batch.flush();
+		}
+		Defer(const Defer&) = delete;
+		Defer& operator=(const Defer&) = delete;
+	private:
+		ImmediateBatch& batch;
+	};
+
+	void begin(GLenum mode)
+	{
+		this->mode = mode;
+		this->primitive.clear();
+	}
+	void end()
+	{
+		this->assemble();
+		this->primitive.clear();
+		size_t total = 0;
+		for (const Bucket& bucket : this->buckets)
+			total += bucket.size();
+		if (total >= MAX_VERTICES)
+			this->draw();
+	}
+
+	void vertex3f(GLfloat x, GLfloat y, GLfloat z)
+	{
+		if (this->normalDirty) {
+			this->normalMatrix = glm::inverseTranspose(glm::mat3(this->matrix));
+			this->normalDirty = false;
+		}
+		const glm::vec4 p = this->matrix * glm::vec4(x, y, z, 1.0f);
+		const glm::vec3 n = this->normalMatrix * this->normal;
+		Vertex v;
+		v.position[0] = p.x;
+		v.position[1] = p.y;
+		v.position[2] = p.z;
+		v.normal[0] = n.x;
+		v.normal[1] = n.y;
+		v.normal[2] = n.z;
+		std::memcpy(v.color, this->color, sizeof(v.color));
+		this->primitive.push_back(v);
+	}
+	void vertex3d(GLdouble x, GLdouble y, GLdouble z) { this->vertex3f((GLfloat)x, (GLfloat)y, (GLfloat)z); }
+	void vertex3fv(const GLfloat* v) { this->vertex3f(v[0], v[1], v[2]); }
+
+	void normal3f(GLfloat x, GLfloat y, GLfloat z) { this->normal = glm::vec3(x, y, z); }
+	void normal3d(GLdouble x, GLdouble y, GLdouble z) { this->normal3f((GLfloat)x, (GLfloat)y, (GLfloat)z); }
+
+	void color4ub(GLubyte r, GLubyte g, GLubyte b, GLubyte a)
+	{
+		this->color[0] = r;
+		this->color[1] = g;
+		this->color[2] = b;
+		this->color[3] = a;
+		this->colored = true;
+	}
+	void color3ub(GLubyte r, GLubyte g, GLubyte b) { this->color4ub(r, g, b, 255); }
+	void color4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+	{
+		this->color4ub(toByte(r), toByte(g), toByte(b), toByte(a));
+	}
+	void color3f(GLfloat r, GLfloat g, GLfloat b) { this->color4f(r, g, b, 1.0f); }
+	void color3fv(const GLfloat* c) { this->color4f(c[0], c[1], c[2], 1.0f); }
+	void color4fv(const GLfloat* c) { this->color4f(c[0], c[1], c[2], c[3]); }
+
+	// on the vertices from here on, like the gl* matrix calls on the
+	// modelview (angles in degrees)
+	void pushMatrix() { this->stack.push_back(this->matrix); }
+	void popMatrix()
+	{
+		if (this->stack.empty())
+			return;
+		this->matrix = this->stack.back();
+		this->stack.pop_back();
+		this->normalDirty = true;
+	}
+	void translate(GLfloat x, GLfloat y, GLfloat z)
+	{
+		this->matrix = glm::translate(this->matrix, glm::vec3(x, y, z));
+	}
+	void rotate(GLfloat degrees, GLfloat x, GLfloat y, GLfloat z)
+	{
+		this->matrix = glm::rotate(this->matrix, glm::radians(degrees), glm::vec3(x, y, z));
+		this->normalDirty = true;
+	}
+	void scale(GLfloat x, GLfloat y, GLfloat z)
+	{
+		this->matrix = glm::scale(this->matrix, glm::vec3(x, y, z));
+		this->normalDirty = true;
+	}
+
+	// draw everything since the last flush - unless a Defer is open
+	void flush()
+	{
+		if (this->deferred == 0)
+			this->draw();
+	}
+
+	// the vertex arena (the buffer is counted in GpuResources)
+	size_t memoryUsed() const
+	{
+		return this->arena.stats().capacity;
+	}
+
+private:
+	struct Vertex
+	{
+		GLfloat position[3];
+		GLfloat normal[3];
+		GLubyte color[4];
+	};
+	typedef ArenaVector<Vertex> Bucket;
+
+	// triangles, lines, points - each without and with colors
+	enum { TRIANGLES, LINES, POINTS, KINDS };
+	static const int BUCKETS = KINDS * 2;
+
+	ImmediateBatch():
+		arena(1 << 16), primitive(ArenaAllocator<Vertex>(this->arena)),
+		mode(GL_TRIANGLES), normal(0.0f, 0.0f, 1.0f), colored(false),
+		matrix(1.0f), normalMatrix(1.0f), normalDirty(false),
+		deferred(0), vbo(0), capacity(0)
+	{
+		this->color[0] = this->color[1] = this->color[2] = this->color[3] = 255;
+		for (int i = 0; i < BUCKETS; ++i)
+			this->buckets.emplace_back(ArenaAllocator<Vertex>(this->arena));
+	}
+
+	static GLubyte toByte(GLfloat c)
+	{
+		return static_cast<GLubyte>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	// the vertices between begin and end into their bucket, as GL would
+	// have put them together
+	void assemble()
+	{
+		const Bucket& p = this->primitive;
+		const size_t n = p.size();
+		const int colorOffset = this->colored ? KINDS : 0;
+		Bucket& triangles = this->buckets[TRIANGLES + colorOffset];
+		Bucket& lines = this->buckets[LINES + colorOffset];
+		Bucket& points = this->buckets[POINTS + colorOffset];
+		auto triangle = [&](size_t a, size_t b, size_t c) {
+			triangles.push_back(p[a]);
+			triangles.push_back(p[b]);
+			triangles.push_back(p[c]);
+		};
+		auto line = [&](size_t a, size_t b) {
+			lines.push_back(p[a]);
+			lines.push_back(p[b]);
+		};
+
+		switch (this->mode) {
+			case GL_POINTS:
+				points.insert(points.end(), p.begin(), p.end());
+				break;
+			case GL_LINES:
+				for (size_t i = 0; i + 1 < n; i += 2)
+					line(i, i + 1);
+				break;
+			case GL_LINE_STRIP:
+			case GL_LINE_LOOP:
+				for (size_t i = 0; i + 1 < n; ++i)
+					line(i, i + 1);
+				if (this->mode == GL_LINE_LOOP && n > 2)
+					line(n - 1, 0);
+				break;
+			case GL_TRIANGLES:
+				for (size_t i = 0; i + 2 < n; i += 3)
+					triangle(i, i + 1, i + 2);
+				break;
+			case GL_TRIANGLE_STRIP:
+				for (size_t i = 0; i + 2 < n; ++i) {
+					if (i % 2 == 0)
+						triangle(i, i + 1, i + 2);
+					else
+						triangle(i + 1, i, i + 2);
+				}
+				break;
+			case GL_TRIANGLE_FAN:
+			case GL_POLYGON:
+				for (size_t i = 1; i + 1 < n; ++i)
+					triangle(0, i, i + 1);
+				break;
+			case GL_QUADS:
+				for (size_t i = 0; i + 3 < n; i += 4) {
+					triangle(i, i + 1, i + 2);
+					triangle(i, i + 2, i + 3);
+				}
+				break;
+			case GL_QUAD_STRIP:
+				for (size_t i = 0; i + 3 < n; i += 2) {
+					triangle(i, i + 1, i + 3);
+					triangle(i, i + 3, i + 2);
+				}
+				break;
+		}
+	}
+
+	// one upload, one draw per bucket, and the arena back to empty
+	void draw()
+	{
+		size_t total = 0;
+		for (const Bucket& bucket : this->buckets)
+			total += bucket.size();
+
+		if (total > 0) {
+			Vertex* all = static_cast<Vertex*>(this->arena.allocate(total * sizeof(Vertex), alignof(Vertex)));
+			size_t at = 0;
+			for (const Bucket& bucket : this->buckets) {
+				if (!bucket.empty())
+					std::memcpy(all + at, bucket.data(), bucket.size() * sizeof(Vertex));
+				at += bucket.size();
+			}
+
+			glBindVertexArray(0);
+			if (!this->vbo)
+				genBuffers(1, &this->vbo, "ImmediateBatch");
+			glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+			if (total > this->capacity) {
+				this->capacity = std::max(total, this->capacity * 2);
+				bufferData(GL_ARRAY_BUFFER, this->vbo, this->capacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+			}
+			else {
+				// a fresh store, so the draws still reading the old one don't stall us
+				glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+			}
+			glBufferSubData(GL_ARRAY_BUFFER, 0, total * sizeof(Vertex), all);
+
+			glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_NORMAL_ARRAY);
+			glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position));
+			glNormalPointer(GL_FLOAT, sizeof(Vertex), (GLvoid*)offsetof(Vertex, normal));
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, color));
+			static const GLenum modes[KINDS] = { GL_TRIANGLES, GL_LINES, GL_POINTS };
+			GLint first = 0;
+			for (int i = 0; i < BUCKETS; ++i) {
+				const GLsizei count = static_cast<GLsizei>(this->buckets[i].size());
+				if (count == 0)
+					continue;
+				if (i >= KINDS)
+					glEnableClientState(GL_COLOR_ARRAY);
+				else
+					glDisableClientState(GL_COLOR_ARRAY);
+				glDrawArrays(modes[i % KINDS], first, count);
+				first += count;
+			}
+			glPopClientAttrib();
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			// the color array leaves GL's current color undefined
+			if (this->colored)
+				glColor4ubv(this->color);
+		}
+
+		for (Bucket& bucket : this->buckets)
+			Bucket(ArenaAllocator<Vertex>(this->arena)).swap(bucket);
+		Bucket(ArenaAllocator<Vertex>(this->arena)).swap(this->primitive);
+		this->arena.reset();
+		this->colored = false;
+	}
+
+	FrameArena arena;
+	std::vector<Bucket> buckets;
+	Bucket primitive;			// between begin and end
+
+	GLenum mode;
+	glm::vec3 normal;
+	GLubyte color[4];
+	bool colored;				// a color was given since the last flush
+
+	glm::mat4 matrix;
+	glm::mat3 normalMatrix;
+	bool normalDirty;
+	std::vector<glm::mat4> stack;
+
+	int deferred;
+	GLuint vbo;
+	size_t capacity;			// vertices the buffer holds
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GpuResources.h"
+
+// A pixel unpack buffer that stays mapped for its whole life
+// (GL_MAP_PERSISTENT_BIT, GL 4.4). It is split into a ring of regions so
+// the CPU can fill one region while the GPU is still copying out of the
+// previous one - every region gets a fence when its copy is issued and
+// map() waits on that fence before handing the region back out.
+//
+//		float* texels = (float*)pbo.map();
+//		... write one image ...
+//		pbo.upload(texture, width, height, GL_RGBA, GL_FLOAT);
+class PixelBuffer
+{
+public:
+	static const int REGIONS = 2;
+
+	PixelBuffer(GLsizeiptr region_size):
+		regionSize(region_size), current(0)
+	{
+		for (int i = 0; i < REGIONS; ++i)
+			this->fences[i] = nullptr;
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &this->id);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->id);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, this->regionSize * REGIONS, nullptr, flags);
+		this->data = static_cast<char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->regionSize * REGIONS, flags));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		GpuResources::instance().created(GpuResources::BUFFER, this->id, "PixelBuffer",
+			static_cast<size_t>(this->regionSize) * REGIONS);
+	}
+	~PixelBuffer()
+	{
+		for (int i = 0; i < REGIONS; ++i)
+			if (this->fences[i])
+				glDeleteSync(this->fences[i]);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->id);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		GpuResources::instance().deleted(GpuResources::BUFFER, this->id);
+		glDeleteBuffers(1, &this->id);
+	}
+
+	// the region to write next - blocks only if the GPU is still reading it
+	void* map()
+	{
+		if (!this->data)
+			return nullptr;
+		GLsync& fence = this->fences[this->current];
+		if (fence) {
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		return this->data + this->regionSize * this->current;
+	}
+
+	// copy the region from the last map() into the texture and move on
+	void upload(GLuint texture, GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->id);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type,
+			reinterpret_cast<const void*>(static_cast<GLintptr>(this->regionSize * this->current)));
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		this->fences[this->current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->current = (this->current + 1) % REGIONS;
+	}
+
+	bool valid() const { return this->data != nullptr; }
+	GLsizeiptr size() const { return this->regionSize; }
+private:
+	GLuint id;
+	GLsizeiptr regionSize;
+	char* data;
+	GLsync fences[REGIONS];
+	int current;
+};
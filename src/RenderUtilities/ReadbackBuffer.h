@@ -0,0 +1,88 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GpuResources.h"
+
+// A pixel pack buffer that stays mapped for its whole life - the reading
+// half of PixelBuffer. It is a ring of regions: read() starts copying the
+// framebuffer into one region and returns straight away, and pixels()
+// hands the copy out once its fence says the GPU is done, which is a
+// frame or two later if the caller keeps reading into the other regions
+// in the meantime.
+//
+//		int region = readback.read(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE);
+//		... draw the next frames ...
+//		const void* frame = readback.pixels(region);
+class ReadbackBuffer
+{
+public:
+	static const int REGIONS = 3;
+
+	ReadbackBuffer(GLsizeiptr region_size):
+		regionSize(region_size), current(0)
+	{
+		for (int i = 0; i < REGIONS; ++i)
+			this->fences[i] = nullptr;
+
+		const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &this->id);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->id);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, this->regionSize * REGIONS, nullptr, flags);
+		this->data = static_cast<const char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->regionSize * REGIONS, flags));
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		GpuResources::instance().created(GpuResources::BUFFER, this->id, "ReadbackBuffer",
+			static_cast<size_t>(this->regionSize) * REGIONS);
+	}
+	~ReadbackBuffer()
+	{
+		for (int i = 0; i < REGIONS; ++i)
+			if (this->fences[i])
+				glDeleteSync(this->fences[i]);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->id);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		GpuResources::instance().deleted(GpuResources::BUFFER, this->id);
+		glDeleteBuffers(1, &this->id);
+	}
+
+	// the region the next read() goes into
+	int next() const { return this->current; }
+
+	// start copying the read framebuffer into the next region. the
+	// region must have been collected with pixels() since it was last read
+	int read(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		const int region = this->current;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->id);
+		glReadPixels(x, y, width, height, format, type,
+			reinterpret_cast<void*>(static_cast<GLintptr>(this->regionSize * region)));
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		this->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->current = (this->current + 1) % REGIONS;
+		return region;
+	}
+
+	// a region that was read - blocks only if the GPU is still writing it.
+	// good until the region is read into again
+	const void* pixels(int region)
+	{
+		GLsync& fence = this->fences[region];
+		if (fence) {
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		return this->data + this->regionSize * region;
+	}
+
+	bool valid() const { return this->data != nullptr; }
+	GLsizeiptr size() const { return this->regionSize; }
+private:
+	GLuint id;
+	GLsizeiptr regionSize;
+	const char* data;
+	GLsync fences[REGIONS];
+	int current;
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GpuResources.h"
+
+// An offscreen color and depth/stencil framebuffer (the stencil is for
+// the shadows), for a view that is not drawn every frame: draw into it
+// after bind(), and blit() it onto the window every frame in between.
+//
+//		if (target.resize(width, height)) {
+//			target.bind();
+//			... draw the view ...
+//		}
+//		target.blit(0, x, y);
+class RenderTarget
+{
+public:
+	RenderTarget(const char* owner):
+		owner(owner), fbo(0), color(0), depthStencil(0), width(0), height(0), complete(false)
+	{
+	}
+	~RenderTarget()
+	{
+		this->release();
+	}
+
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	// make the buffers width x height, if they aren't already. whatever
+	// was drawn is gone when they change. false if the framebuffer can't
+	// be drawn into
+	bool resize(int width, int height)
+	{
+		if (this->matches(width, height))
+			return this->complete;
+		this->release();
+		if (width <= 0 || height <= 0)
+			return false;
+		this->width = width;
+		this->height = height;
+
+		glGenFramebuffers(1, &this->fbo);
+		glGenRenderbuffers(1, &this->color);
+		glGenRenderbuffers(1, &this->depthStencil);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, this->depthStencil);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		GpuResources& gpu = GpuResources::instance();
+		const size_t pixels = static_cast<size_t>(width) * height;
+		gpu.created(GpuResources::FRAMEBUFFER, this->fbo, this->owner);
+		gpu.created(GpuResources::RENDERBUFFER, this->color, this->owner, pixels * 4);
+		gpu.created(GpuResources::RENDERBUFFER, this->depthStencil, this->owner, pixels * 4);
+
+		GLint previous = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->depthStencil);
+		this->complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
+		return this->complete;
+	}
+
+	// already width x height - resize would keep what was drawn
+	bool matches(int width, int height) const
+	{
+		return this->fbo && width == this->width && height == this->height;
+	}
+
+	// draw into it from now on
+	void bind() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+	}
+
+	// copy the color onto the framebuffer target, bottom left at x, y.
+	// leaves target bound for drawing
+	void blit(GLuint target, int x, int y) const
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, this->fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+		glBlitFramebuffer(0, 0, this->width, this->height,
+			x, y, x + this->width, y + this->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+	}
+
+	bool valid() const { return this->complete; }
+private:
+	void release()
+	{
+		if (!this->fbo)
+			return;
+		GpuResources& gpu = GpuResources::instance();
+		gpu.deleted(GpuResources::FRAMEBUFFER, this->fbo);
+		gpu.deleted(GpuResources::RENDERBUFFER, this->color);
+		gpu.deleted(GpuResources::RENDERBUFFER, this->depthStencil);
+		glDeleteFramebuffers(1, &this->fbo);
+		glDeleteRenderbuffers(1, &this->color);
+		glDeleteRenderbuffers(1, &this->depthStencil);
+		this->fbo = this->color = this->depthStencil = 0;
+		this->width = this->height = 0;
+		this->complete = false;
+	}
+
+	const char* owner;
+	GLuint fbo;
+	GLuint color;
+	GLuint depthStencil;
+	int width;
+	int height;
+	bool complete;
+};
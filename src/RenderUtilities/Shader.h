@@ -9,6 +9,8 @@
 #include <iostream>
 #include <vector>
 
+#include "GpuResources.h"
+
 
 
 class Shader
@@ -74,7 +76,18 @@ public:
 
 		for (GLuint shader : shaders)
 			glDeleteShader(shader);
+
+		// named after the fragment shader, or whatever stage it has
+		const char* owner = frag ? frag : vert ? vert : geom ? geom : tese ? tese : tesc;
+		GpuResources::instance().created(GpuResources::PROGRAM, this->Program, owner ? owner : "Shader");
+	}
+	~Shader()
+	{
+		GpuResources::instance().deleted(GpuResources::PROGRAM, this->Program);
+		glDeleteProgram(this->Program);
 	}
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
 	// Uses the current shader
 	void Use()
 	{
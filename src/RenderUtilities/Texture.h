@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "GpuResources.h"
+
 
 class Texture2D
 {
@@ -37,14 +39,48 @@ public:
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		if(img.type() == CV_8UC3)
+		size_t bytes = 0;
+		if(img.type() == CV_8UC3) {
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, img.cols, img.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, img.data);
-		else if (img.type() == CV_8UC4)
+			bytes = static_cast<size_t>(img.cols) * img.rows * 3;
+		}
+		else if (img.type() == CV_8UC4) {
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, img.cols, img.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, img.data);
+			bytes = static_cast<size_t>(img.cols) * img.rows * 4;
+		}
 		glBindTexture(GL_TEXTURE_2D, 0);
+		GpuResources::instance().created(GpuResources::TEXTURE, this->id, path, bytes);
 
 		img.release();
 	}
+	// an empty texture of the given size, filled later with glTexSubImage2D
+	// (e.g. through a PixelBuffer)
+	Texture2D(int width, int height, GLenum internal_format, Type texture_type = Texture2D::TEXTURE_DEFAULT):
+		type(texture_type)
+	{
+		this->size.x = width;
+		this->size.y = height;
+
+		glGenTextures(1, &this->id);
+
+		glBindTexture(GL_TEXTURE_2D, this->id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width, height);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		GpuResources::instance().created(GpuResources::TEXTURE, this->id, "Texture2D (empty)",
+			static_cast<size_t>(width) * height * texelBytes(internal_format));
+	}
+	~Texture2D()
+	{
+		GpuResources::instance().deleted(GpuResources::TEXTURE, this->id);
+		glDeleteTextures(1, &this->id);
+	}
+	Texture2D(const Texture2D&) = delete;
+	Texture2D& operator=(const Texture2D&) = delete;
+
 	void bind(GLenum bind_unit)
 	{
 		glActiveTexture(GL_TEXTURE0 + bind_unit);
@@ -55,8 +91,21 @@ public:
 		glActiveTexture(GL_TEXTURE0 + bind_unit);
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
+	GLuint getId() const { return this->id; }
 	glm::ivec2 size;
 private:
+	// what one texel of the sized internal formats in use takes
+	static size_t texelBytes(GLenum internal_format)
+	{
+		switch (internal_format) {
+		case GL_RGBA32F: return 16;
+		case GL_RGBA16F: return 8;
+		case GL_RGB8: return 3;
+		case GL_R8: return 1;
+		default: return 4;
+		}
+	}
+
 	GLuint id;
 
 };
\ No newline at end of file
@@ -0,0 +1,200 @@
+/************************************************************************
+     File:        ResourceOverlay.cpp
+
+     Comment:     The GL object and heap overlay. See ResourceOverlay.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "ResourceOverlay.H"
+
+#include <cstring>
+
+#include <glad/glad.h>
+#include <Fl/gl.h>
+
+#include "RenderUtilities/GpuResources.h"
+
+//****************************************************************************
+//
+// * A row for every kind of GL object to start with
+//============================================================================
+ResourceOverlay::
+ResourceOverlay()
+	: first(true)
+//============================================================================
+{
+	for (int k = 0; k < GpuResources::KIND_COUNT; ++k) {
+		Row row;
+		row.name = GpuResources::kindName(static_cast<GpuResources::Kind>(k));
+		row.gpu = true;
+		rows.push_back(row);
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ResourceOverlay::
+setHeap(const char* subsystem, size_t bytes)
+//============================================================================
+{
+	for (Row& row : rows)
+		if (!row.gpu && row.name == subsystem) {
+			row.heap = bytes;
+			return;
+		}
+	Row row;
+	row.name = subsystem;
+	row.heap = bytes;
+	rows.push_back(row);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ResourceOverlay::
+update()
+//============================================================================
+{
+	const GpuResources::Totals& totals = GpuResources::instance().totals();
+	for (size_t i = 0; i < rows.size(); ++i) {
+		Row& row = rows[i];
+		if (row.gpu)
+			take(row, totals.count[i], totals.bytes[i]);
+		else
+			take(row, 0, row.heap);
+	}
+	first = false;
+}
+
+//****************************************************************************
+//
+// * The new numbers into row. growth is anything going up - fewer objects
+//   holding more bytes still counts
+//============================================================================
+void ResourceOverlay::
+take(Row& row, size_t count, size_t bytes)
+//============================================================================
+{
+	row.countDelta = first ? 0 : static_cast<long long>(count) - static_cast<long long>(row.count);
+	row.bytesDelta = first ? 0 : static_cast<long long>(bytes) - static_cast<long long>(row.bytes);
+	row.count = count;
+	row.bytes = bytes;
+
+	if (row.countDelta > 0 || row.bytesDelta > 0) {
+		row.sinceGrowth = 0;
+		++row.growingFor;
+	}
+	else {
+		if (row.sinceGrowth < HOLD_FRAMES)
+			++row.sinceGrowth;
+		row.growingFor = 0;
+		row.warned = false;
+	}
+
+	if (row.growingFor >= LEAK_FRAMES && !row.warned) {
+		printf("%s has grown every frame for %u frames: %zu%s, %.1f KB\n",
+			   row.name.c_str(), row.growingFor, row.gpu ? count : bytes,
+			   row.gpu ? " objects" : " bytes", bytes / 1024.0);
+		row.warned = true;
+	}
+}
+
+//****************************************************************************
+//
+// * Everything GL state it needs is pushed and popped again, so it can go
+//   at the end of any frame
+//============================================================================
+void ResourceOverlay::
+draw(int width, int height) const
+//============================================================================
+{
+	const int lineHeight = 14;
+	const int panelWidth = 420;
+	const int panelHeight = static_cast<int>(rows.size() + 2) * lineHeight;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT);
+	glUseProgram(0);
+	glBindVertexArray(0);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_STENCIL_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, width, 0, height, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
+	glBegin(GL_QUADS);
+	glVertex2i(4, height - 4);
+	glVertex2i(4 + panelWidth, height - 4);
+	glVertex2i(4 + panelWidth, height - 4 - panelHeight);
+	glVertex2i(4, height - 4 - panelHeight);
+	glEnd();
+
+	gl_font(FL_COURIER, 12);
+	int y = height - 4 - lineHeight + 3;
+	char line[160];
+
+	glColor3f(1.0f, 1.0f, 1.0f);
+	snprintf(line, sizeof(line), "%-16s %8s %12s %14s", "", "count", "KB", "this frame");
+	gl_draw(line, 10, y);
+	y -= lineHeight;
+
+	for (size_t i = 0; i < rows.size(); ++i) {
+		const Row& row = rows[i];
+		if (i == GpuResources::KIND_COUNT)
+			y -= lineHeight / 2;		// the heap rows, a little apart
+
+		if (row.sinceGrowth < HOLD_FRAMES)
+			glColor3f(1.0f, 0.3f, 0.3f);
+		else
+			glColor3f(0.8f, 1.0f, 0.8f);
+
+		char count[16] = "";
+		if (row.gpu)
+			snprintf(count, sizeof(count), "%zu", row.count);
+		char delta[32] = "";
+		if (row.countDelta != 0)
+			snprintf(delta, sizeof(delta), "%+lld ", row.countDelta);
+		if (row.bytesDelta != 0)
+			snprintf(delta + strlen(delta), sizeof(delta) - strlen(delta), "%+.1fKB", row.bytesDelta / 1024.0);
+
+		snprintf(line, sizeof(line), "%-16s %8s %12.1f %14s", row.name.c_str(), count, row.bytes / 1024.0, delta);
+		gl_draw(line, 10, y);
+		y -= lineHeight;
+	}
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopAttrib();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ResourceOverlay::
+report(FILE* out) const
+//============================================================================
+{
+	GpuResources::instance().report(out);
+	fprintf(out, "heap:\n");
+	for (const Row& row : rows)
+		if (!row.gpu)
+			fprintf(out, "  %-28s %10.1f KB\n", row.name.c_str(), row.bytes / 1024.0);
+	fflush(out);
+}
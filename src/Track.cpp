@@ -26,14 +26,74 @@
 
 #include "Track.H"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
 #include <FL/fl_ask.h>
 
+#include "TrackTextParser.H"
+#include "Utilities/MappedFile.H"
+
+namespace {
+	const char kTrackMagic[4] = { 'C', 'T', 'R', 'K' };
+
+	// on-disk header of a .trk file, see Track.H for the layout
+	struct TrackFileHeader {
+		char		magic[4];
+		uint32_t	version;
+		uint32_t	flags;
+		uint32_t	metadataStride;
+		uint64_t	pointCount;
+		uint32_t	checksum;
+		uint32_t	headerSize;
+	};
+
+	const uint32_t kFnvOffset = 2166136261u;
+
+	// how much is read between looks at the cancel flag
+	const size_t kCancelBlock = 4 << 20;
+
+	bool cancelled(const std::atomic<bool>* cancel)
+	{
+		return cancel && *cancel;
+	}
+
+	// FNV-1a, continued from hash so the payload can be fed in pieces
+	uint32_t fnv1a(const void* data, size_t size, uint32_t hash)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= p[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	bool hasExtension(const char* filename, const char* ext)
+	{
+		size_t n = strlen(filename);
+		size_t e = strlen(ext);
+		if (n < e)
+			return false;
+		for (size_t i = 0; i < e; ++i) {
+			char c = filename[n - e + i];
+			if (c >= 'A' && c <= 'Z')
+				c = c - 'A' + 'a';
+			if (c != ext[i])
+				return false;
+		}
+		return true;
+	}
+}
+
 //****************************************************************************
 //
 // * Constructor
 //============================================================================
 CTrack::
-CTrack() : trainU(0)
+CTrack() : trainU(0), metadataStride(0), revision(0)
 //============================================================================
 {
 	resetPoints();
@@ -54,125 +114,279 @@ resetPoints()
 	points.push_back(ControlPoint(Pnt3f(-50,5,0)));
 	points.push_back(ControlPoint(Pnt3f(0,5,-50)));
 
+	metadata.clear();
+	metadataStride = 0;
+	markChanged();
+
 	// we had better put the train back at the start of the track...
 	trainU = 0.0;
 }
 
 //****************************************************************************
 //
-// * Handy utility to break a string into a list of words
+// * The metadata is one flat array, so this moves everything after the
+//   point - only on tracks that have any
 //============================================================================
-void breakString(char* str, std::vector<const char*>& words) 
+void CTrack::
+insertPoint(size_t i, const ControlPoint& point)
 //============================================================================
 {
-	// start with no words
-	words.clear();
+	if (i > points.size())
+		i = points.size();
+	if (metadataStride > 0 && metadata.size() == metadataStride * points.size())
+		metadata.insert(metadata.begin() + i * metadataStride, metadataStride, 0);
+	points.insert(i, point);
+}
 
-	// scan through the string, starting at the beginning
-	char* p = str;
+//****************************************************************************
+//
+// *
+//============================================================================
+void CTrack::
+erasePoint(size_t i)
+//============================================================================
+{
+	if (i >= points.size())
+		return;
+	if (metadataStride > 0 && metadata.size() == metadataStride * points.size()) {
+		const vector<unsigned char>::iterator at = metadata.begin() + i * metadataStride;
+		metadata.erase(at, at + metadataStride);
+	}
+	points.erase(i);
+}
 
-	// stop when we hit the end of the string
-	while(*p) {
-		// skip over leading whitespace - stop at the first character or end of string
-		while (*p && *p<=' ') p++;
+//****************************************************************************
+//
+// * Read a track file, complaining with an alert if it goes wrong
+//============================================================================
+void CTrack::
+readPoints(const char* filename)
+//============================================================================
+{
+	std::string error;
+	if (!readPoints(filename, error))
+		fl_alert("%s", error.c_str());
+}
 
-		// now we're pointing at the first thing after the spaces
-		// make sure its not a comment, and that we're not at the end of the string
-		// (that's actually the same thing)
-		if (! (*p) || *p == '#')
-		break;
+//****************************************************************************
+//
+// * Read a track file - binary if it starts with the .trk magic, otherwise
+//   the old text format
+//============================================================================
+bool CTrack::
+readPoints(const char* filename, std::string& error, const std::atomic<bool>* cancel)
+//============================================================================
+{
+	bool ok = false;
+	MappedFile file;
+	if (!file.open(filename)) {
+		error = "Can't Open File!\n";
+	}
+	else if (file.size() >= sizeof(kTrackMagic) &&
+			 memcmp(file.data(), kTrackMagic, sizeof(kTrackMagic)) == 0) {
+		ok = readBinaryPoints(file.data(), file.size(), error, cancel);
+	}
+	else {
+		ok = readTextPoints(file.data(), file.size(), error, cancel);
+	}
+	if (!ok && cancelled(cancel))
+		error = "Cancelled";
+	if (ok)
+		markChanged();
+	trainU = 0;
+	return ok;
+}
 
-		// so we're pointing at a word! add it to the word list
-		words.push_back(p);
+//****************************************************************************
+//
+// * The binary format - check the header and the checksum, then copy the
+//   floats straight out of the mapped file
+//============================================================================
+bool CTrack::
+readBinaryPoints(const char* data, size_t size, std::string& error,
+				 const std::atomic<bool>* cancel)
+//============================================================================
+{
+	TrackFileHeader header;
+	if (size < sizeof(header)) {
+		error = "Track file is truncated";
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
 
-		// now find the end of the word
-		while(*p > ' ') p++;	// stop at space or end of string
+	if (header.version != TRK_VERSION || header.headerSize != sizeof(header)) {
+		char message[64];
+		sprintf(message, "Unsupported track file version %u", header.version);
+		error = message;
+		return false;
+	}
+	if (header.pointCount < 4) {
+		error = "Illegal Number of Points Specified in File";
+		return false;
+	}
 
-		// if its ethe end of the string, we're done
-		if (! *p) break;
+	// the counts come from the file - check them against its size by
+	// dividing, so no product of them can wrap around
+	const bool hasMetadata = (header.flags & TRK_HAS_METADATA) != 0;
+	const uint64_t stride = hasMetadata ? header.metadataStride : 0;
+	const uint64_t available = size - sizeof(header);
+	if (header.pointCount > available / (6 * sizeof(float))) {
+		error = "Track file is truncated";
+		return false;
+	}
+	const uint64_t pointBytes = header.pointCount * 6 * sizeof(float);
+	if (stride != 0 && header.pointCount > (available - pointBytes) / stride) {
+		error = "Track file is truncated";
+		return false;
+	}
+	const uint64_t metadataBytes = header.pointCount * stride;
+	if (pointBytes + metadataBytes != available) {
+		error = "Track file is truncated";
+		return false;
+	}
 
-		// otherwise, turn this space into and end of string (to end the word)
-		// and keep going
-		*p = 0;
-		p++;
+	const char* payload = data + sizeof(header);
+	uint32_t hash = kFnvOffset;
+	for (uint64_t done = 0; done < available; done += kCancelBlock) {
+		if (cancelled(cancel))
+			return false;
+		const uint64_t block = (available - done < kCancelBlock) ? available - done : kCancelBlock;
+		hash = fnv1a(payload + done, static_cast<size_t>(block), hash);
 	}
+	if (hash != header.checksum) {
+		error = "Track file is corrupt (checksum mismatch)";
+		return false;
+	}
+
+	// the header is 32 bytes and the mapping starts on a page, so the
+	// floats are aligned where they lie
+	if (cancelled(cancel))
+		return false;
+	points.assign(reinterpret_cast<const float*>(payload), static_cast<size_t>(header.pointCount));
+
+	metadataStride = static_cast<size_t>(stride);
+	metadata.assign(payload + pointBytes, payload + pointBytes + metadataBytes);
+	return true;
 }
 
 //****************************************************************************
 //
-// * The file format is simple
+// * The text file format is simple
 //   first line: an integer with the number of control points
 //	  other lines: one line per control point
 //   either 3 (X,Y,Z) numbers on the line, or 6 numbers (X,Y,Z, orientation)
+//   see TrackTextParser.H for the details
 //============================================================================
-void CTrack::
-readPoints(const char* filename)
+bool CTrack::
+readTextPoints(const char* data, size_t size, std::string& error,
+			   const std::atomic<bool>* cancel)
 //============================================================================
 {
-	FILE* fp = fopen(filename,"r");
-	if (!fp) {
-		fl_alert("Can't Open File!\n");
-	} 
-	else {
-		char buf[512];
-
-		// first line = number of points
-		fgets(buf,512,fp);
-		size_t npts = (size_t) atoi(buf);
-
-		if( (npts<4) || (npts>65535)) {
-			fl_alert("Illegal Number of Points Specified in File");
-		} else {
-			points.clear();
-			// get lines until EOF or we have enough points
-			while( (points.size() < npts) && fgets(buf,512,fp) ) {
-				Pnt3f pos,orient;
-				vector<const char*> words;
-				breakString(buf,words);
-				if (words.size() >= 3) {
-					pos.x = (float) strtod(words[0],0);
-					pos.y = (float) strtod(words[1],0);
-					pos.z = (float) strtod(words[2],0);
-				} else {
-					pos.x=0;
-					pos.y=0;
-					pos.z=0;
-				}
-				if (words.size() >= 6) {
-					orient.x = (float) strtod(words[3],0);
-					orient.y = (float) strtod(words[4],0);
-					orient.z = (float) strtod(words[5],0);
-				} else {
-					orient.x = 0;
-					orient.y = 1;
-					orient.z = 0;
-				}
-				orient.normalize();
-				points.push_back(ControlPoint(pos,orient));
-			}
-		}
-		fclose(fp);
+	std::vector<ControlPoint> loaded;
+	if (!parseTrackText(data, size, loaded, cancel)) {
+		error = "Illegal Number of Points Specified in File";
+		return false;
 	}
-	trainU = 0;
+	points.assign(loaded);
+	metadata.clear();
+	metadataStride = 0;
+	return true;
 }
 
 //****************************************************************************
 //
-// * write the control points to our simple format
+// * write the control points - ".trk" files get the binary format
 //============================================================================
 void CTrack::
 writePoints(const char* filename)
 //============================================================================
+{
+	if (hasExtension(filename, ".trk"))
+		writeBinaryPoints(filename);
+	else
+		writeTextPoints(filename);
+}
+
+//****************************************************************************
+//
+// * write the control points to our simple text format
+//   %.9g is enough digits for every float to read back exactly
+//============================================================================
+void CTrack::
+writeTextPoints(const char* filename)
+//============================================================================
 {
 	FILE* fp = fopen(filename,"w");
 	if (!fp) {
 		fl_alert("Can't open file for writing");
 	} else {
-		fprintf(fp,"%d\n",points.size());
-		for(size_t i=0; i<points.size(); ++i)
-			fprintf(fp,"%g %g %g %g %g %g\n",
-				points[i].pos.x, points[i].pos.y, points[i].pos.z, 
-				points[i].orient.x, points[i].orient.y, points[i].orient.z);
+		fprintf(fp,"%lu\n",(unsigned long) points.size());
+		for (const ControlPoint point : points)
+			fprintf(fp,"%.9g %.9g %.9g %.9g %.9g %.9g\n",
+				point.pos.x, point.pos.y, point.pos.z, 
+				point.orient.x, point.orient.y, point.orient.z);
 		fclose(fp);
 	}
 }
+
+//****************************************************************************
+//
+// * write the control points to the binary format
+//   the checksum is only known at the end, so the header is written twice
+//============================================================================
+void CTrack::
+writeBinaryPoints(const char* filename)
+//============================================================================
+{
+	FILE* fp = fopen(filename,"wb");
+	if (!fp) {
+		fl_alert("Can't open file for writing");
+		return;
+	}
+
+	const bool writeMetadata = metadataStride > 0 &&
+		metadata.size() == metadataStride * points.size();
+
+	TrackFileHeader header;
+	memcpy(header.magic, kTrackMagic, sizeof(kTrackMagic));
+	header.version = TRK_VERSION;
+	header.flags = writeMetadata ? TRK_HAS_METADATA : 0;
+	header.metadataStride = writeMetadata ? static_cast<uint32_t>(metadataStride) : 0;
+	header.pointCount = points.size();
+	header.checksum = 0;
+	header.headerSize = sizeof(header);
+	fwrite(&header, sizeof(header), 1, fp);
+
+	// go through a buffer so fwrite isn't called once per float. the
+	// points are kept as arrays of x, y, z..., the file has them point by
+	// point - interleave a chunk at a time
+	uint32_t hash = kFnvOffset;
+	vector<float> buffer;
+	buffer.reserve(ControlPointList::MAX_CHUNK * 6);
+	for (size_t c = 0; c < points.chunkCount(); ++c) {
+		const ControlPointList::Span span = points.chunk(c);
+		buffer.clear();
+		for (size_t j = 0; j < span.count; ++j) {
+			buffer.push_back(span.x[j]);
+			buffer.push_back(span.y[j]);
+			buffer.push_back(span.z[j]);
+			buffer.push_back(span.ox[j]);
+			buffer.push_back(span.oy[j]);
+			buffer.push_back(span.oz[j]);
+		}
+		hash = fnv1a(buffer.data(), buffer.size() * sizeof(float), hash);
+		fwrite(buffer.data(), sizeof(float), buffer.size(), fp);
+	}
+	if (writeMetadata) {
+		hash = fnv1a(metadata.data(), metadata.size(), hash);
+		fwrite(metadata.data(), 1, metadata.size(), fp);
+	}
+
+	header.checksum = hash;
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, fp);
+
+	if (ferror(fp))
+		fl_alert("Error while writing the track file");
+	fclose(fp);
+}
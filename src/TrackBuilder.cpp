@@ -0,0 +1,165 @@
+/************************************************************************
+     File:        TrackBuilder.cpp
+
+     Comment:     Rebuilds the track geometry on the thread pool.
+						See TrackBuilder.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "TrackBuilder.H"
+
+#pragma warning(push)
+#pragma warning(disable:4312)
+#pragma warning(disable:4311)
+#include <Fl/Fl.H>
+#pragma warning(pop)
+
+#include "Utilities/ThreadPool.H"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+TrackBuilder::
+TrackBuilder(ReadyCallback ready, void* data)
+	: ready(ready), readyData(data), running(false), generation(0), fresh(false)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * The build job uses this object, so wait for it to finish
+//============================================================================
+TrackBuilder::
+~TrackBuilder()
+//============================================================================
+{
+	discard();
+	std::unique_lock<std::mutex> guard(lock);
+	idle.wait(guard, [this] { return !running; });
+}
+
+//****************************************************************************
+//
+// * Hand a copy of the points to a build job. the copy shares the list's
+//   chunks (see ControlPointList.H), so it is cheap here on the UI thread;
+//   the job flattens it for the build on the pool
+//   the back buffer is the one from a discarded build, or the old front
+//   buffer if nobody is drawing it any more - otherwise a new one
+//============================================================================
+bool TrackBuilder::
+request(const ControlPointList& points, unsigned revision,
+		int splineChoice, float divideLine, int railProfile)
+//============================================================================
+{
+	unsigned jobGeneration;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (running)
+			return false;
+
+		if (!building) {
+			if (spare && spare.use_count() == 1)
+				building = std::move(spare);
+			else
+				building = std::make_shared<TrackGeometry>();
+		}
+		spare.reset();
+
+		control.cancel = false;
+		control.progress = 0.0f;
+		running = true;
+		jobGeneration = generation;
+	}
+
+	ThreadPool::instance().submit(
+		[this, copy = points, revision, splineChoice, divideLine, railProfile, jobGeneration]() {
+			run(copy, revision, splineChoice, divideLine, railProfile, jobGeneration);
+		});
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrackBuilder::
+discard()
+//============================================================================
+{
+	std::lock_guard<std::mutex> guard(lock);
+	++generation;
+	control.cancel = true;
+	fresh = false;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool TrackBuilder::
+busy() const
+//============================================================================
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return running;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+std::shared_ptr<const TrackGeometry> TrackBuilder::
+takeFinished()
+//============================================================================
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (!fresh)
+		return std::shared_ptr<const TrackGeometry>();
+	fresh = false;
+	return published;
+}
+
+//****************************************************************************
+//
+// * The build job - runs on a pool worker
+//   nobody else touches the back buffer while running is set, so the
+//   build itself needs no lock
+//============================================================================
+void TrackBuilder::
+run(const ControlPointList& snapshot, unsigned revision,
+	int splineChoice, float divideLine, int railProfile, unsigned jobGeneration)
+//============================================================================
+{
+	std::vector<ControlPoint> points;
+	snapshot.copyTo(points);
+
+	// the published geometry is only ever replaced by this job, so it can
+	// be read here without the lock - rail chunks that come out the same
+	// are shared with it instead of being remeshed
+	const bool built = building->build(points, splineChoice, divideLine, railProfile,
+									   &control, published.get());
+
+	ReadyCallback callback = ready;
+	void* callbackData = readyData;
+	bool publishedNew = false;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (built && jobGeneration == generation) {
+			building->revision = revision;
+			spare = std::move(published);
+			published = std::move(building);
+			fresh = true;
+			publishedNew = true;
+		}
+		running = false;
+		// still under the lock - the destructor may be waiting on this
+		idle.notify_all();
+	}
+
+	if (publishedNew && callback)
+		Fl::awake(callback, callbackData);
+}
@@ -0,0 +1,772 @@
+/************************************************************************
+     File:        TrackGeometry.cpp
+
+     Comment:     Spline evaluation and the cached track geometry.
+						See TrackGeometry.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "TrackGeometry.H"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "Utilities/ThreadPool.H"
+
+const float TrackGeometry::SLEEPER_SPACING = 8.0f;
+SplineSampling TrackGeometry::sampling = SAMPLE_FORWARD_DIFFERENCES;
+
+namespace {
+	// tessellateSegment evaluates exactly again this often
+	const int RESEED = 64;
+
+	size_t wrapIndex(int idx, size_t count)
+	{
+		if (count == 0)
+			return 0;
+		int mod = idx % static_cast<int>(count);
+		if (mod < 0)
+			mod += static_cast<int>(count);
+		return static_cast<size_t>(mod);
+	}
+
+	Pnt3f lerp(const Pnt3f& a, const Pnt3f& b, float t)
+	{
+		return a * (1.0f - t) + b * t;
+	}
+
+	float lengthSquared(const Pnt3f& v)
+	{
+		return v.x * v.x + v.y * v.y + v.z * v.z;
+	}
+
+	Pnt3f normalizeVector(const Pnt3f& v)
+	{
+		Pnt3f copy = v;
+		copy.normalize();
+		return copy;
+	}
+
+	float distanceBetween(const Pnt3f& a, const Pnt3f& b)
+	{
+		return std::sqrt(lengthSquared(b - a));
+	}
+
+	// walks a cubic a t^3 + b t^2 + c t + d in even steps of h with three
+	// adds a step. seed() puts it exactly at t again, which stops the
+	// rounding of the adds from piling up
+	struct ForwardDifferences {
+		glm::vec3	value;
+		glm::vec3	d1, d2, d3;		// first, second and third differences
+
+		void seed(const glm::vec3 c[4], float t, float h)
+		{
+			const float h2 = h * h;
+			const float h3 = h2 * h;
+			value = ((c[0] * t + c[1]) * t + c[2]) * t + c[3];
+			d1 = c[0] * (3.0f * t * t * h + 3.0f * t * h2 + h3) + c[1] * (2.0f * t * h + h2) + c[2] * h;
+			d2 = c[0] * (6.0f * t * h2 + 6.0f * h3) + c[1] * (2.0f * h2);
+			d3 = c[0] * (6.0f * h3);
+		}
+
+		void next()
+		{
+			value += d1;
+			d1 += d2;
+			d2 += d3;
+		}
+	};
+
+	void pushVertex(std::vector<float>& out, const Pnt3f& p)
+	{
+		out.push_back(p.x);
+		out.push_back(p.y);
+		out.push_back(p.z);
+	}
+
+	glm::vec3 toVec(const Pnt3f& p)
+	{
+		return glm::vec3(p.x, p.y, p.z);
+	}
+
+	Pnt3f toPnt(const glm::vec3& v)
+	{
+		return Pnt3f(v.x, v.y, v.z);
+	}
+
+	// the frame looking along forward with up as close to up as it can be
+	// (forward and up must not be parallel)
+	glm::quat frameFromAxes(const glm::vec3& forward, const glm::vec3& up)
+	{
+		const glm::vec3 f = glm::normalize(forward);
+		const glm::vec3 r = glm::normalize(glm::cross(f, up));
+		const glm::vec3 u = glm::cross(r, f);
+		return glm::normalize(glm::quat_cast(glm::mat3(r, u, -f)));
+	}
+
+	// any vector at right angles to t
+	glm::vec3 perpendicular(const glm::vec3& t)
+	{
+		const glm::vec3 a = glm::abs(t);
+		const glm::vec3 axis = (a.x <= a.y && a.x <= a.z) ? glm::vec3(1, 0, 0)
+			: (a.y <= a.z) ? glm::vec3(0, 1, 0) : glm::vec3(0, 0, 1);
+		return glm::cross(t, axis);
+	}
+
+	// carry the frame from x0 to x1, where the tangent is t1 - the double
+	// reflection method (Wang et al., "Computation of Rotation Minimizing
+	// Frames", 2008): reflect across the plane halfway between x0 and x1,
+	// then across the one that lines the reflected tangent up with t1
+	glm::quat transportFrame(const glm::quat& frame, const glm::vec3& x0, const glm::vec3& x1, const glm::vec3& t1)
+	{
+		glm::vec3 r = frame * glm::vec3(0, 1, 0);
+		glm::vec3 t = frame * glm::vec3(0, 0, -1);
+
+		const glm::vec3 v1 = x1 - x0;
+		const float c1 = glm::dot(v1, v1);
+		if (c1 > 1e-12f) {
+			r -= (2.0f / c1) * glm::dot(v1, r) * v1;
+			t -= (2.0f / c1) * glm::dot(v1, t) * v1;
+		}
+		const glm::vec3 v2 = t1 - t;
+		const float c2 = glm::dot(v2, v2);
+		if (c2 > 1e-12f)
+			r -= (2.0f / c2) * glm::dot(v2, r) * v2;
+		return frameFromAxes(t1, r);
+	}
+
+	// the angle to roll frame by, about its forward axis, to bring its up
+	// as close to up as it goes. otherwise (up along forward) fallback
+	float rollTowards(const glm::quat& frame, const glm::vec3& up, float fallback)
+	{
+		const glm::vec3 forward = frame * glm::vec3(0, 0, -1);
+		const glm::vec3 frameUp = frame * glm::vec3(0, 1, 0);
+		const glm::vec3 across = up - glm::dot(up, forward) * forward;
+		if (glm::dot(across, across) < 1e-8f)
+			return fallback;
+		return std::atan2(glm::dot(glm::cross(frameUp, across), forward), glm::dot(frameUp, across));
+	}
+
+	// into -pi..pi
+	float wrapAngle(float angle)
+	{
+		const float pi = 3.14159265f;
+		angle = std::fmod(angle + pi, 2.0f * pi);
+		if (angle < 0.0f)
+			angle += 2.0f * pi;
+		return angle - pi;
+	}
+
+	// the four control points a segment's shape comes from
+	void segmentPoints(const std::vector<ControlPoint>& points, int segment,
+					   glm::vec3 pos[4], glm::vec3 orient[4])
+	{
+		const size_t pointCount = points.size();
+		for (int i = 0; i < 4; ++i) {
+			const ControlPoint& point = points[wrapIndex(segment - 1 + i, pointCount)];
+			pos[i] = toVec(point.pos);
+			orient[i] = toVec(point.orient);
+		}
+	}
+
+	// one sample, t along the segment
+	template <class Basis>
+	SplineSample evaluateSegment(const std::vector<ControlPoint>& points, int segment, float t)
+	{
+		glm::vec3 pos[4], orient[4];
+		segmentPoints(points, segment, pos, orient);
+		float weights[4], derivatives[4];
+		basisWeights<Basis>(t, weights);
+		basisDerivatives<Basis>(t, derivatives);
+
+		SplineSample sample;
+		sample.pos = toPnt(basisBlend<Basis>(weights, pos));
+		sample.orient = normalizeVector(toPnt(basisBlend<Basis>(weights, orient)));
+		sample.tangent = toPnt(basisBlend<Basis>(derivatives, pos));
+		sample.param = static_cast<float>(segment) + t;
+		return sample;
+	}
+
+	// steps + 1 even samples over the segment, by forward differences of
+	// its polynomials. every RESEED steps they are evaluated exactly again
+	template <class Basis>
+	void tessellateSegment(const std::vector<ControlPoint>& points, size_t segment, int steps,
+						   SplineSample* out)
+	{
+		glm::vec3 points4[4], orients4[4];
+		segmentPoints(points, static_cast<int>(segment), points4, orients4);
+
+		// a b c d of the position and orientation, and the tangent (their
+		// derivative, 0 3a 2b c)
+		glm::vec3 pos[4], orient[4], tangent[4];
+		basisCoefficients<Basis>(points4, pos);
+		basisCoefficients<Basis>(orients4, orient);
+		tangent[0] = glm::vec3(0.0f);
+		tangent[1] = 3.0f * pos[0];
+		tangent[2] = 2.0f * pos[1];
+		tangent[3] = pos[2];
+
+		const float h = 1.0f / static_cast<float>(steps);
+		ForwardDifferences p, o, t;
+		for (int step = 0; step <= steps; ++step) {
+			if (step % RESEED == 0) {
+				const float at = static_cast<float>(step) * h;
+				p.seed(pos, at, h);
+				o.seed(orient, at, h);
+				t.seed(tangent, at, h);
+			}
+			SplineSample& sample = out[step];
+			sample.pos = toPnt(p.value);
+			sample.orient = normalizeVector(toPnt(o.value));
+			sample.tangent = toPnt(t.value);
+			sample.param = static_cast<float>(segment) + static_cast<float>(step) * h;
+			p.next();
+			o.next();
+			t.next();
+		}
+		// sampleSpline puts the last step on the next segment - which only
+		// makes a difference where the tangent jumps between segments
+		if (!Basis::SMOOTH)
+			out[steps].tangent = evaluateSegment<Basis>(points, static_cast<int>(segment) + 1, 0.0f).tangent;
+	}
+}
+
+//****************************************************************************
+//
+// * Evaluate the spline at u - it wraps around, the track is closed
+//============================================================================
+SplineSample sampleSpline(const std::vector<ControlPoint>& points, float u, int splineChoice)
+//============================================================================
+{
+	SplineSample sample{};
+	if (points.empty())
+		return sample;
+
+	const size_t pointCount = points.size();
+	const float totalSpan = static_cast<float>(pointCount);
+	float wrappedU = std::fmod(u, totalSpan);
+	if (wrappedU < 0.0f)
+		wrappedU += totalSpan;
+	int baseSeg = static_cast<int>(std::floor(wrappedU));
+	float localT = wrappedU - static_cast<float>(baseSeg);
+	baseSeg = static_cast<int>(wrapIndex(baseSeg, pointCount));
+
+	withSplineBasis(splineChoice, pointCount, [&](auto basis) {
+		sample = evaluateSegment<decltype(basis)>(points, baseSeg, localT);
+	});
+	return sample;
+}
+
+//****************************************************************************
+//
+// * The same samples sampleSpline gives at segment + step / steps for
+//   step = 0..steps, but the basis is only picked and worked out once
+//============================================================================
+void
+sampleSegment(const std::vector<ControlPoint>& points, size_t segment, int steps,
+			  int splineChoice, SplineSample* out)
+//============================================================================
+{
+	if (points.empty() || steps < 1)
+		return;
+	withSplineBasis(splineChoice, points.size(), [&](auto basis) {
+		tessellateSegment<decltype(basis)>(points, segment, steps, out);
+	});
+}
+
+//****************************************************************************
+//
+// * The directions of a frame
+//============================================================================
+Pnt3f TrackFrame::
+forward() const
+//============================================================================
+{
+	return toPnt(rotation * glm::vec3(0, 0, -1));
+}
+
+Pnt3f TrackFrame::
+up() const
+//============================================================================
+{
+	return toPnt(rotation * glm::vec3(0, 1, 0));
+}
+
+Pnt3f TrackFrame::
+right() const
+//============================================================================
+{
+	return toPnt(rotation * glm::vec3(1, 0, 0));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool TrackGeometry::
+matches(unsigned trackRevision, int spline, float divide, int profile) const
+//============================================================================
+{
+	return revision == trackRevision && splineChoice == spline && divideLine == divide
+		&& railProfile == profile;
+}
+
+//****************************************************************************
+//
+// * Walk the spline and fill everything in
+//   every pass runs over ranges of segments on the thread pool:
+//     1) sample the steps and measure each segment, and carry a frame
+//        along the segment starting from any roll at all
+//     2) (serial, a few operations per segment) prefix sum the segment
+//        lengths - sleeper k sits at arc length (k + 1) * SLEEPER_SPACING,
+//        so the prefix sum says which sleepers land in which segment.
+//        the frame carried along a segment is a rotation of its start
+//        frame, so chaining those rotations gives every segment its real
+//        start frame
+//     3) turn the frames of each segment into the real ones - banked by
+//        the control points' roll - then place its sleepers
+//     4) sweep the rail profile along the frames, a chunk of segments at
+//        a time (chunks the previous build already has are kept)
+//     5) the per-segment tables for advanceTrain
+//   nothing a segment computes depends on how the ranges were cut, so the
+//   result is the same for any number of threads
+//============================================================================
+bool TrackGeometry::
+build(const std::vector<ControlPoint>& points, int spline, float divide, int profile,
+	  TrackBuildControl* control, const TrackGeometry* previous)
+//============================================================================
+{
+	splineChoice = spline;
+	divideLine = divide;
+	railProfile = profile;
+	pointCount = points.size();
+	railChunks.clear();
+	sleeperVertices.clear();
+	sleeperNormals.clear();
+	sleepers.clear();
+	sleeperFrames.clear();
+	frames.clear();
+	segmentArcLengths.clear();
+	segmentSleeperCounts.clear();
+
+	if (pointCount < 2)
+		return true;
+
+	stepsPerSegment = (divide < 1.0f) ? 1 : static_cast<int>(divide);
+	const size_t stepBudget = std::max<size_t>(1, MAX_STEPS / pointCount);
+	if (static_cast<size_t>(stepsPerSegment) > stepBudget)
+		stepsPerSegment = static_cast<int>(stepBudget);
+
+	const size_t stride = static_cast<size_t>(stepsPerSegment) + 1;
+	const float invSteps = 1.0f / static_cast<float>(stepsPerSegment);
+	const double spacing = SLEEPER_SPACING;
+
+	ThreadPool& pool = ThreadPool::instance();
+	const size_t grain = std::max<size_t>(1, pointCount / (static_cast<size_t>(pool.concurrency()) * 8));
+	std::atomic<size_t> segmentsDone{0};
+	auto reportProgress = [&](size_t segments, float from, float share) {
+		if (!control)
+			return;
+		const size_t done = segmentsDone.fetch_add(segments) + segments;
+		control->progress = from + share * static_cast<float>(done) / static_cast<float>(pointCount);
+	};
+
+	// 1) steps, segment lengths and the frames along each segment
+	steps.resize(pointCount * stride);
+	frames.resize(pointCount * stride);
+	segmentStarts.resize(pointCount + 1);
+
+	pool.parallelFor(0, pointCount, grain, [&](size_t first, size_t last) {
+		for (size_t segIdx = first; segIdx < last; ++segIdx) {
+			if (control && control->cancel)
+				return;
+
+			const float baseU = static_cast<float>(segIdx);
+			SplineSample* segSteps = &steps[segIdx * stride];
+			double length = 0.0;
+			if (sampling == SAMPLE_EXACT) {
+				for (int step = 0; step <= stepsPerSegment; ++step)
+					segSteps[step] = sampleSpline(points, baseU + step * invSteps, spline);
+			}
+			else
+				sampleSegment(points, segIdx, stepsPerSegment, spline, segSteps);
+			for (int step = 0; step < stepsPerSegment; ++step) {
+				const float stepLength = distanceBetween(segSteps[step].pos, segSteps[step + 1].pos);
+				if (stepLength >= 1e-5f)
+					length += stepLength;
+			}
+			// the lengths go in shifted by one, the prefix sum moves them up
+			segmentStarts[segIdx + 1] = length;
+
+			// the frames need a unit tangent everywhere - where the spline
+			// stands still use the direction to the next step instead
+			for (int step = 0; step <= stepsPerSegment; ++step) {
+				Pnt3f& tangent = segSteps[step].tangent;
+				if (lengthSquared(tangent) < 1e-12f) {
+					tangent = (step < stepsPerSegment) ? segSteps[step + 1].pos - segSteps[step].pos
+													   : segSteps[step].pos - segSteps[step - 1].pos;
+					if (lengthSquared(tangent) < 1e-12f)
+						tangent = (step > 0) ? segSteps[step - 1].tangent : Pnt3f(0.0f, 0.0f, 1.0f);
+				}
+				tangent.normalize();
+			}
+
+			glm::quat* segFrames = &frames[segIdx * stride];
+			const glm::vec3 t0 = toVec(segSteps[0].tangent);
+			segFrames[0] = frameFromAxes(t0, perpendicular(t0));
+			for (int step = 0; step < stepsPerSegment; ++step)
+				segFrames[step + 1] = transportFrame(segFrames[step], toVec(segSteps[step].pos),
+													 toVec(segSteps[step + 1].pos), toVec(segSteps[step + 1].tangent));
+		}
+		reportProgress(last - first, 0.0f, 0.5f);
+	});
+	if (control && control->cancel)
+		return false;
+
+	// 2) where every segment starts along the track, its first sleeper and
+	//    its start frame. the first frame is as close to the first control
+	//    point's orientation as the tangent allows
+	segmentStarts[0] = 0.0;
+	firstSleepers.resize(pointCount + 1);
+	firstSleepers[0] = 0;
+	for (size_t segIdx = 1; segIdx <= pointCount; ++segIdx) {
+		segmentStarts[segIdx] += segmentStarts[segIdx - 1];
+		firstSleepers[segIdx] = static_cast<size_t>(std::floor(segmentStarts[segIdx] / spacing));
+	}
+
+	segmentFrames.resize(pointCount + 1);
+	const glm::vec3 startTangent = toVec(steps[0].tangent);
+	glm::vec3 startUp = toVec(steps[0].orient);
+	if (glm::length(glm::cross(startTangent, startUp)) < 1e-3f)
+		startUp = perpendicular(startTangent);
+	segmentFrames[0] = frameFromAxes(startTangent, startUp);
+	for (size_t segIdx = 0; segIdx < pointCount; ++segIdx) {
+		const size_t base = segIdx * stride;
+		const size_t next = ((segIdx + 1) % pointCount) * stride;
+		const glm::quat end = glm::normalize(frames[base + stepsPerSegment] * glm::conjugate(frames[base]) * segmentFrames[segIdx]);
+		segmentFrames[segIdx + 1] = transportFrame(end, toVec(steps[base + stepsPerSegment].pos),
+												   toVec(steps[next].pos), toVec(steps[next].tangent));
+	}
+
+	// going once around doesn't bring the frame back to where it started -
+	// spread the difference out over the whole length as a slow roll
+	const glm::vec3 upAround = segmentFrames[pointCount] * glm::vec3(0, 1, 0);
+	const glm::vec3 upStart = segmentFrames[0] * glm::vec3(0, 1, 0);
+	const float closingAngle = std::atan2(glm::dot(glm::cross(upAround, upStart), startTangent),
+										  glm::dot(upAround, upStart));
+	const double totalLength = segmentStarts[pointCount];
+	const double rollPerLength = (totalLength > 1e-6) ? closingAngle / totalLength : 0.0;
+
+	// the bank at each segment start: how far the blended orientation there
+	// is rolled from the carried frame. along a segment it goes from one to
+	// the next the short way round
+	std::vector<float> banks(pointCount + 1);
+	for (size_t segIdx = 0; segIdx < pointCount; ++segIdx) {
+		const float closing = static_cast<float>(rollPerLength * segmentStarts[segIdx]);
+		const glm::quat frame = segmentFrames[segIdx] * glm::angleAxis(closing, glm::vec3(0, 0, -1));
+		banks[segIdx] = rollTowards(frame, toVec(steps[segIdx * stride].orient),
+									(segIdx > 0) ? banks[segIdx - 1] : 0.0f);
+	}
+	banks[pointCount] = banks[0];
+	for (size_t segIdx = 1; segIdx <= pointCount; ++segIdx)
+		banks[segIdx] = banks[segIdx - 1] + wrapAngle(banks[segIdx] - banks[segIdx - 1]);
+
+	const size_t sleeperTotal = firstSleepers[pointCount];
+	sleepers.resize(sleeperTotal);
+	sleeperFrames.resize(sleeperTotal);
+	sleeperVertices.resize(sleeperTotal * 12);
+	sleeperNormals.resize(sleeperTotal * 12);
+	if (control)
+		control->progress = 0.55f;
+
+	// 3) each segment fixes up its frames, then walks its steps to its
+	//    sleepers
+	segmentsDone = 0;
+	pool.parallelFor(0, pointCount, grain, [&](size_t first, size_t last) {
+		for (size_t segIdx = first; segIdx < last; ++segIdx) {
+			if (control && control->cancel)
+				return;
+
+			const SplineSample* segSteps = &steps[segIdx * stride];
+			glm::quat* segFrames = &frames[segIdx * stride];
+			const glm::quat toReal = glm::conjugate(segFrames[0]) * segmentFrames[segIdx];
+			const double segmentLength = segmentStarts[segIdx + 1] - segmentStarts[segIdx];
+			double arc = segmentStarts[segIdx];
+			for (int step = 0; step <= stepsPerSegment; ++step) {
+				if (step > 0) {
+					const float stepLength = distanceBetween(segSteps[step - 1].pos, segSteps[step].pos);
+					if (stepLength >= 1e-5f)
+						arc += stepLength;
+				}
+				const double along = (segmentLength > 1e-6)
+					? std::min(1.0, (arc - segmentStarts[segIdx]) / segmentLength)
+					: static_cast<double>(step) / stepsPerSegment;
+				const float bank = banks[segIdx] + static_cast<float>(along) * (banks[segIdx + 1] - banks[segIdx]);
+				const float roll = static_cast<float>(rollPerLength * arc) + bank;
+				segFrames[step] = glm::normalize(segFrames[step] * toReal * glm::angleAxis(roll, glm::vec3(0, 0, -1)));
+			}
+
+			size_t k = firstSleepers[segIdx];
+			const size_t kEnd = firstSleepers[segIdx + 1];
+			if (k == kEnd)
+				continue;
+
+			double stepStart = segmentStarts[segIdx];
+			int lastStep = 0;
+			for (int step = 0; step < stepsPerSegment && k < kEnd; ++step) {
+				const float stepLength = distanceBetween(segSteps[step].pos, segSteps[step + 1].pos);
+				if (stepLength < 1e-5f)
+					continue;
+				lastStep = step;
+				// the last step takes whatever rounding left over
+				const double stepEnd = (step + 1 == stepsPerSegment)
+					? segmentStarts[segIdx + 1] : stepStart + stepLength;
+				for (; k < kEnd && static_cast<double>(k + 1) * spacing <= stepEnd; ++k) {
+					const double ratio = (static_cast<double>(k + 1) * spacing - stepStart) / stepLength;
+					placeSleeper(k, segIdx, step, static_cast<float>(std::min(1.0, std::max(0.0, ratio))));
+				}
+				stepStart = stepEnd;
+			}
+			// and if the steps came up short of the segment end, the rest
+			// go at the end of the last step
+			for (; k < kEnd; ++k)
+				placeSleeper(k, segIdx, lastStep, 1.0f);
+		}
+		reportProgress(last - first, 0.55f, 0.25f);
+	});
+	if (control && control->cancel)
+		return false;
+
+	// 4) the rail meshes, a chunk at a time
+	if (!buildRailChunks(previous, control))
+		return false;
+
+	if (sleepers.empty()) {
+		SplineSample fallback = steps[0];
+		fallback.orient = toPnt(frames[0] * glm::vec3(0, 1, 0));
+		fallback.tangent = toPnt(frames[0] * glm::vec3(0, 0, -1));
+		fallback.param = 0.0f;
+		sleepers.push_back(fallback);
+		sleeperFrames.push_back(frames[0]);
+		firstSleepers.assign(pointCount + 1, 1);
+		firstSleepers[0] = 0;
+	}
+
+	// 5)
+	buildSegmentTables(grain);
+
+	if (control)
+		control->progress = 1.0f;
+	return true;
+}
+
+//****************************************************************************
+//
+// * Sleeper k, ratio of the way along the given step: everything about it
+//   comes straight out of the step and frame tables
+//============================================================================
+void TrackGeometry::
+placeSleeper(size_t k, size_t segIdx, int step, float ratio)
+//============================================================================
+{
+	const size_t index = segIdx * (static_cast<size_t>(stepsPerSegment) + 1) + step;
+	const glm::quat frame = glm::normalize(glm::slerp(frames[index], frames[index + 1], ratio));
+
+	SplineSample& sleeper = sleepers[k];
+	sleeper.pos = lerp(steps[index].pos, steps[index + 1].pos, ratio);
+	sleeper.orient = toPnt(frame * glm::vec3(0, 1, 0));
+	sleeper.tangent = toPnt(frame * glm::vec3(0, 0, -1));
+	sleeper.param = static_cast<float>(segIdx) + (step + ratio) / static_cast<float>(stepsPerSegment);
+	sleeperFrames[k] = frame;
+
+	setSleeperQuad(k, sleeper.pos, frame);
+}
+
+//****************************************************************************
+//
+// * Where the train is at trainU (in sleepers) - in between two sleepers
+//   the position is blended and the frame slerped
+//============================================================================
+TrackFrame TrackGeometry::
+trainFrame(float trainU) const
+//============================================================================
+{
+	TrackFrame frame;
+	const size_t count = sleepers.size();
+	if (count == 0)
+		return frame;
+
+	const float total = static_cast<float>(count);
+	float u = std::fmod(trainU, total);
+	if (u < 0.0f)
+		u += total;
+	size_t idx0 = static_cast<size_t>(u);
+	if (idx0 >= count)
+		idx0 = count - 1;
+	const size_t idx1 = (idx0 + 1) % count;
+	const float interp = u - static_cast<float>(idx0);
+
+	frame.pos = lerp(sleepers[idx0].pos, sleepers[idx1].pos, interp);
+	frame.rotation = glm::normalize(glm::slerp(sleeperFrames[idx0], sleeperFrames[idx1], interp));
+	return frame;
+}
+
+//****************************************************************************
+//
+// * What every vector has reserved - the build scratch too, it is kept
+//============================================================================
+size_t TrackGeometry::
+memoryUsed() const
+//============================================================================
+{
+	size_t bytes = railChunks.capacity() * sizeof(std::shared_ptr<const RailChunk>);
+	for (const std::shared_ptr<const RailChunk>& chunk : railChunks)
+		bytes += sizeof(RailChunk)
+			+ chunk->ringPositions.capacity() * sizeof(glm::vec3)
+			+ chunk->ringFrames.capacity() * sizeof(glm::quat)
+			+ chunk->vertices.capacity() * sizeof(float)
+			+ chunk->indices.capacity() * sizeof(unsigned);
+	bytes += (sleeperVertices.capacity() + sleeperNormals.capacity()) * sizeof(float);
+	bytes += sleepers.capacity() * sizeof(SplineSample);
+	bytes += (sleeperFrames.capacity() + frames.capacity() + segmentFrames.capacity()) * sizeof(glm::quat);
+	bytes += (segmentArcLengths.capacity() + segmentSleeperCounts.capacity()) * sizeof(float);
+	bytes += steps.capacity() * sizeof(SplineSample);
+	bytes += segmentStarts.capacity() * sizeof(double);
+	bytes += firstSleepers.capacity() * sizeof(size_t);
+	return bytes;
+}
+
+//****************************************************************************
+//
+// * Cut the track into chunks of about CHUNK_RINGS rings and sweep the
+//   rail profile along each one. the rings are every ringStride-th step
+//   (so a huge track doesn't get a huge mesh) plus the end of every
+//   segment, so neighbouring chunks always meet
+//============================================================================
+bool TrackGeometry::
+buildRailChunks(const TrackGeometry* previous, TrackBuildControl* control)
+//============================================================================
+{
+	const size_t stride = static_cast<size_t>(stepsPerSegment) + 1;
+	const size_t totalSteps = pointCount * static_cast<size_t>(stepsPerSegment);
+	const int ringStride = static_cast<int>((totalSteps + MAX_RAIL_RINGS - 1) / MAX_RAIL_RINGS);
+	const size_t ringsPerSegment = static_cast<size_t>((stepsPerSegment + ringStride - 1) / ringStride) + 1;
+	const size_t segmentsPerChunk = std::max<size_t>(1, CHUNK_RINGS / ringsPerSegment);
+	const size_t chunkCount = (pointCount + segmentsPerChunk - 1) / segmentsPerChunk;
+
+	railChunks.resize(chunkCount);
+	ThreadPool::instance().parallelFor(0, chunkCount, 1, [&](size_t first, size_t last) {
+		std::vector<glm::vec3> ringPositions;
+		std::vector<glm::quat> ringFrames;
+		for (size_t c = first; c < last; ++c) {
+			if (control && control->cancel)
+				return;
+
+			const size_t firstSegment = c * segmentsPerChunk;
+			const size_t segmentCount = std::min(segmentsPerChunk, pointCount - firstSegment);
+			ringPositions.clear();
+			ringFrames.clear();
+			for (size_t segIdx = firstSegment; segIdx < firstSegment + segmentCount; ++segIdx) {
+				const size_t base = segIdx * stride;
+				for (int step = 0; step <= stepsPerSegment; step += ringStride) {
+					ringPositions.push_back(toVec(steps[base + step].pos));
+					ringFrames.push_back(frames[base + step]);
+				}
+				if (stepsPerSegment % ringStride != 0) {
+					ringPositions.push_back(toVec(steps[base + stepsPerSegment].pos));
+					ringFrames.push_back(frames[base + stepsPerSegment]);
+				}
+			}
+
+			if (previous && c < previous->railChunks.size()) {
+				const std::shared_ptr<const RailChunk>& old = previous->railChunks[c];
+				if (old && old->firstSegment == firstSegment && old->segmentCount == segmentCount
+					&& railChunkSweptAlong(*old, railProfile, ringPositions, ringFrames)) {
+					railChunks[c] = old;
+					continue;
+				}
+			}
+
+			std::shared_ptr<RailChunk> chunk = std::make_shared<RailChunk>();
+			chunk->firstSegment = firstSegment;
+			chunk->segmentCount = segmentCount;
+			sweepRailProfile(*chunk, railProfile, ringPositions, ringFrames);
+			railChunks[c] = chunk;
+		}
+	});
+	return !(control && control->cancel);
+}
+
+//****************************************************************************
+//
+// * Sleeper i's quad, lying across the track
+//============================================================================
+void TrackGeometry::
+setSleeperQuad(size_t i, const Pnt3f& center, const glm::quat& frame)
+//============================================================================
+{
+	const float sleeperHalfWidth = 3.0f;
+	const float sleeperHalfLength = 2.0f;
+
+	const Pnt3f right = toPnt(frame * glm::vec3(sleeperHalfWidth, 0, 0));
+	const Pnt3f forward = toPnt(frame * glm::vec3(0, 0, -sleeperHalfLength));
+	const Pnt3f normal = toPnt(frame * glm::vec3(0, 1, 0));
+
+	const Pnt3f corners[4] = {
+		center - forward - right,
+		center - forward + right,
+		center + forward + right,
+		center + forward - right
+	};
+	float* vertex = &sleeperVertices[i * 12];
+	float* normalOut = &sleeperNormals[i * 12];
+	for (int c = 0; c < 4; ++c) {
+		vertex[c * 3 + 0] = corners[c].x;
+		vertex[c * 3 + 1] = corners[c].y;
+		vertex[c * 3 + 2] = corners[c].z;
+		normalOut[c * 3 + 0] = normal.x;
+		normalOut[c * 3 + 1] = normal.y;
+		normalOut[c * 3 + 2] = normal.z;
+	}
+}
+
+//****************************************************************************
+//
+// * How long each control point segment is, measured sleeper to sleeper,
+//   and how many sleepers it holds
+//============================================================================
+void TrackGeometry::
+buildSegmentTables(size_t grain)
+//============================================================================
+{
+	segmentArcLengths.assign(pointCount, 0.0f);
+	segmentSleeperCounts.assign(pointCount, 0.0f);
+
+	const size_t sampleCount = sleepers.size();
+	ThreadPool::instance().parallelFor(0, pointCount, grain, [&](size_t first, size_t last) {
+		for (size_t segIdx = first; segIdx < last; ++segIdx) {
+			const size_t begin = firstSleepers[segIdx];
+			const size_t end = firstSleepers[segIdx + 1];
+			float length = 0.0f;
+			for (size_t i = begin; i < end; ++i)
+				length += distanceBetween(sleepers[i].pos, sleepers[(i + 1) % sampleCount].pos);
+			segmentArcLengths[segIdx] = length;
+			segmentSleeperCounts[segIdx] = static_cast<float>(end - begin);
+		}
+	});
+
+	float totalSamples = std::accumulate(segmentSleeperCounts.begin(), segmentSleeperCounts.end(), 0.0f);
+	if (totalSamples > 1e-4f)
+		averageSleepersPerSegment = totalSamples / static_cast<float>(pointCount);
+	else
+		averageSleepersPerSegment = 1.0f;
+
+	float totalLength = std::accumulate(segmentArcLengths.begin(), segmentArcLengths.end(), 0.0f);
+	if (totalLength > 1e-4f)
+		averageArcLengthPerSegment = totalLength / static_cast<float>(pointCount);
+	else
+		averageArcLengthPerSegment = SLEEPER_SPACING;
+}
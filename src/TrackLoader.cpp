@@ -0,0 +1,181 @@
+/************************************************************************
+     File:        TrackLoader.cpp
+
+     Comment:     Loads a track file on a worker thread.
+						See TrackLoader.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "TrackLoader.H"
+
+#pragma warning(push)
+#pragma warning(disable:4312)
+#pragma warning(disable:4311)
+#include <Fl/Fl.H>
+#pragma warning(pop)
+
+namespace {
+	// how much of the bar reading the file gets - the rest is the build
+	const float kReadShare = 0.2f;
+}
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+TrackLoader::
+TrackLoader()
+	: running(false), phase(0), current(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * Don't leave a worker running behind us
+//============================================================================
+TrackLoader::
+~TrackLoader()
+//============================================================================
+{
+	cancel();
+	join();
+}
+
+//****************************************************************************
+//
+// * Kick off a load on a new worker
+//============================================================================
+void TrackLoader::
+start(const char* filename, int splineChoice, float divideLine,
+	  int railProfile, DoneCallback done, void* data)
+//============================================================================
+{
+	cancel();
+	join();
+
+	{
+		// whatever the last load left behind is not for this one
+		std::lock_guard<std::mutex> guard(resultLock);
+		result = Result();
+	}
+	control.cancel = false;
+	control.progress = 0.0f;
+	phase = 0;
+	running = true;
+	const unsigned generation = ++current;
+	worker = std::thread(&TrackLoader::run, this, std::string(filename),
+						 splineChoice, divideLine, railProfile, generation, done, data);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrackLoader::
+cancel()
+//============================================================================
+{
+	control.cancel = true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrackLoader::
+join()
+//============================================================================
+{
+	if (worker.joinable())
+		worker.join();
+}
+
+//****************************************************************************
+//
+// * Reading gets the first part of the bar, building the rest
+//============================================================================
+float TrackLoader::
+progress() const
+//============================================================================
+{
+	if (phase == 0)
+		return 0.0f;
+	return kReadShare + (1.0f - kReadShare) * control.progress;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+const char* TrackLoader::
+stage() const
+//============================================================================
+{
+	return (phase == 0) ? "Reading track..." : "Building track...";
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+TrackLoader::Result TrackLoader::
+takeResult()
+//============================================================================
+{
+	std::lock_guard<std::mutex> guard(resultLock);
+	Result taken = std::move(result);
+	result = Result();
+	return taken;
+}
+
+//****************************************************************************
+//
+// * The worker: read, build, then tell the UI thread
+//============================================================================
+void TrackLoader::
+run(std::string filename, int splineChoice, float divideLine,
+	int railProfile, unsigned generation, DoneCallback done, void* data)
+//============================================================================
+{
+	Result loaded;
+	loaded.generation = generation;
+	loaded.ok = loaded.track.readPoints(filename.c_str(), loaded.error, &control.cancel);
+
+	if (loaded.ok && !control.cancel) {
+		phase = 1;
+		loaded.geometry = std::make_shared<TrackGeometry>();
+		std::vector<ControlPoint> points;
+		loaded.track.points.copyTo(points);
+		loaded.ok = loaded.geometry->build(points, splineChoice,
+										   divideLine, railProfile, &control);
+	}
+	loaded.cancelled = control.cancel;
+	if (loaded.cancelled)
+		loaded.ok = false;
+
+	{
+		std::lock_guard<std::mutex> guard(resultLock);
+		result = std::move(loaded);
+	}
+	running = false;
+
+	Fl::awake(deliver, new Message{this, generation, done, data});
+}
+
+//****************************************************************************
+//
+// * A load that was cancelled or replaced can finish after the next one
+//   started - its message is dropped here, on the UI thread
+//============================================================================
+void TrackLoader::
+deliver(void* message)
+//============================================================================
+{
+	const std::unique_ptr<Message> sent(static_cast<Message*>(message));
+	if (sent->generation != sent->loader->generation())
+		return;
+	sent->done(sent->data);
+}
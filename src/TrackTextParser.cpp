@@ -0,0 +1,209 @@
+/************************************************************************
+     File:        TrackTextParser.cpp
+
+     Comment:     Parallel reader for the legacy text track format.
+						See TrackTextParser.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "TrackTextParser.H"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+#include "Utilities/ThreadPool.H"
+
+namespace {
+	// the old reader used fgets(buf, 512, fp) - at most 511 characters a read
+	const size_t kMaxRead = 511;
+
+	// don't bother splitting files smaller than this
+	const size_t kMinChunk = 256 * 1024;
+
+	// pieces between looks at the cancel flag
+	const size_t kCancelPieces = 4096;
+
+	//========================================================================
+	// where the fgets() that starts at p would stop
+	//========================================================================
+	const char* nextPiece(const char* p, const char* end)
+	{
+		const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = nl ? nl + 1 : end;
+		size_t length = lineEnd - p;
+#ifdef _WIN32
+		// text mode hands "\r\n" to fgets as a single '\n'
+		if (nl && nl > p && nl[-1] == '\r')
+			--length;
+#endif
+		if (length <= kMaxRead)
+			return lineEnd;
+		return p + kMaxRead;
+	}
+
+	//========================================================================
+	// strtod(token, 0), rounded to float
+	// from_chars takes the same prefix strtod does for plain decimal
+	// numbers; everything else (hex, '+', inf/nan, out of range) goes to
+	// strtod itself
+	//========================================================================
+	float toFloat(const char* begin, const char* end)
+	{
+		const char* s = begin;
+		if (s < end && *s == '-')
+			++s;
+		bool decimal = s < end && ((*s >= '0' && *s <= '9') || *s == '.');
+		if (decimal && *s == '0' && s + 1 < end && (s[1] == 'x' || s[1] == 'X'))
+			decimal = false;
+
+		if (decimal) {
+			double value;
+			std::from_chars_result r = std::from_chars(begin, end, value);
+			if (r.ec == std::errc())
+				return static_cast<float>(value);
+			if (r.ec == std::errc::invalid_argument)
+				return 0.0f;		// strtod converts nothing and gives 0
+		}
+
+		char buf[kMaxRead + 1];
+		size_t n = std::min(static_cast<size_t>(end - begin), kMaxRead);
+		memcpy(buf, begin, n);
+		buf[n] = 0;
+		return static_cast<float>(strtod(buf, 0));
+	}
+
+	//========================================================================
+	// one piece -> one control point, splitting words the way breakString
+	// did: anything <= ' ' (high bytes too, char is signed) separates words,
+	// a word starting with '#' ends the line, and so does a NUL
+	//========================================================================
+	ControlPoint parsePiece(const char* p, const char* end)
+	{
+		const char* words[6];
+		const char* wordEnds[6];
+		size_t count = 0;
+
+		for (;;) {
+			while (p < end && *p && static_cast<signed char>(*p) <= ' ')
+				++p;
+			if (p >= end || !*p || *p == '#')
+				break;
+
+			const char* word = p;
+			while (p < end && static_cast<signed char>(*p) > ' ')
+				++p;
+			if (count < 6) {
+				words[count] = word;
+				wordEnds[count] = p;
+			}
+			++count;
+
+			if (p >= end || !*p)
+				break;
+			++p;
+		}
+
+		Pnt3f pos, orient;
+		if (count >= 3) {
+			pos.x = toFloat(words[0], wordEnds[0]);
+			pos.y = toFloat(words[1], wordEnds[1]);
+			pos.z = toFloat(words[2], wordEnds[2]);
+		} else {
+			pos.x = 0;
+			pos.y = 0;
+			pos.z = 0;
+		}
+		if (count >= 6) {
+			orient.x = toFloat(words[3], wordEnds[3]);
+			orient.y = toFloat(words[4], wordEnds[4]);
+			orient.z = toFloat(words[5], wordEnds[5]);
+		} else {
+			orient.x = 0;
+			orient.y = 1;
+			orient.z = 0;
+		}
+		orient.normalize();
+		return ControlPoint(pos, orient);
+	}
+}
+
+//****************************************************************************
+//
+// * Read the count line, then count and parse the rest in parallel
+//============================================================================
+bool parseTrackText(const char* data, size_t size, std::vector<ControlPoint>& points,
+					const std::atomic<bool>* cancel)
+//============================================================================
+{
+	auto cancelled = [cancel] { return cancel && *cancel; };
+	const char* end = data + size;
+	if (size == 0)
+		return false;
+
+	// first read = number of points, through atoi like before
+	const char* body = nextPiece(data, end);
+	char countLine[kMaxRead + 1];
+	memcpy(countLine, data, body - data);
+	countLine[body - data] = 0;
+	size_t npts = (size_t) atoi(countLine);
+	if (npts < 4)
+		return false;
+
+	// cut the rest into chunks that start right after a '\n' - a new
+	// fgets always starts there, so every chunk can be split on its own
+	ThreadPool& pool = ThreadPool::instance();
+	const size_t bodySize = end - body;
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(
+		static_cast<size_t>(pool.concurrency()) * 4, bodySize / kMinChunk));
+
+	std::vector<const char*> bounds(chunkCount + 1);
+	bounds[0] = body;
+	for (size_t c = 1; c < chunkCount; ++c) {
+		const char* p = std::max(bounds[c - 1], body + bodySize / chunkCount * c);
+		const char* nl = (p < end) ? static_cast<const char*>(memchr(p, '\n', end - p)) : 0;
+		bounds[c] = nl ? nl + 1 : end;
+	}
+	bounds[chunkCount] = end;
+
+	// pass 1: how many points each chunk holds
+	std::vector<size_t> first(chunkCount + 1, 0);
+	pool.parallelFor(0, chunkCount, 1, [&](size_t b, size_t e) {
+		for (size_t c = b; c < e; ++c) {
+			size_t n = 0;
+			for (const char* p = bounds[c]; p < bounds[c + 1]; p = nextPiece(p, bounds[c + 1])) {
+				if (++n % kCancelPieces == 0 && cancelled())
+					return;
+			}
+			first[c + 1] = n;
+		}
+	});
+	if (cancelled())
+		return false;
+	for (size_t c = 0; c < chunkCount; ++c)
+		first[c + 1] += first[c];
+
+	// pass 2: parse straight into place, stopping at the declared count
+	const size_t total = std::min(npts, first[chunkCount]);
+	std::vector<ControlPoint> parsed(total);
+	pool.parallelFor(0, chunkCount, 1, [&](size_t b, size_t e) {
+		for (size_t c = b; c < e; ++c) {
+			size_t i = first[c];
+			for (const char* p = bounds[c]; p < bounds[c + 1] && i < total; ++i) {
+				if ((i - first[c]) % kCancelPieces == 0 && cancelled())
+					return;
+				const char* q = nextPiece(p, bounds[c + 1]);
+				parsed[i] = parsePiece(p, q);
+				p = q;
+			}
+		}
+	});
+
+	if (cancelled())
+		return false;
+	points.swap(parsed);
+	return true;
+}
@@ -0,0 +1,389 @@
+/************************************************************************
+     File:        TrainSimulation.cpp
+
+     Comment:     The train's own thread. See TrainSimulation.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "TrainSimulation.H"
+
+#include <cmath>
+
+#include "TrackGeometry.H"
+
+namespace {
+	// where trainU wraps round on this geometry
+	float wrapLength(const TrackGeometry* geometry)
+	{
+		if (!geometry)
+			return 0.0f;
+		return geometry->sleepers.empty()
+			? static_cast<float>(geometry->pointCount)
+			: static_cast<float>(geometry->sleepers.size());
+	}
+
+	float wrap(float u, float maxU)
+	{
+		if (maxU <= 0.0f)
+			return u;
+		u = std::fmod(u, maxU);
+		if (u < 0.0f)
+			u += maxU;
+		return u;
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+TrainSimulation::
+TrainSimulation()
+	: u(0.0f), ticks(0), stopping(false)
+//============================================================================
+{
+	publish(0.0f);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+TrainSimulation::
+~TrainSimulation()
+//============================================================================
+{
+	stop();
+}
+
+//****************************************************************************
+//
+// * Whatever was sent so far has been carried out already, so the thread
+//   just takes over from there
+//============================================================================
+void TrainSimulation::
+start()
+//============================================================================
+{
+	if (threaded())
+		return;
+	stopping = false;
+	thread = std::thread(&TrainSimulation::run, this);
+}
+
+//****************************************************************************
+//
+// * Anything still queued is carried out before it returns
+//============================================================================
+void TrainSimulation::
+stop()
+//============================================================================
+{
+	if (!threaded())
+		return;
+	stopping = true;
+	thread.join();
+	Command command;
+	while (commands.pop(command))
+		apply(command);
+	publish(0.0f);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrainSimulation::
+setSettings(const TrainSettings& settings)
+//============================================================================
+{
+	Command command;
+	command.type = Command::SETTINGS;
+	command.settings = settings;
+	send(std::move(command));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrainSimulation::
+setGeometry(std::shared_ptr<const TrackGeometry> geometry)
+//============================================================================
+{
+	Command command;
+	command.type = Command::GEOMETRY;
+	command.geometry = std::move(geometry);
+	send(std::move(command));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrainSimulation::
+place(float trainU)
+//============================================================================
+{
+	Command command;
+	command.type = Command::PLACE;
+	command.value = trainU;
+	send(std::move(command));
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrainSimulation::
+advance(float seconds)
+//============================================================================
+{
+	Command command;
+	command.type = Command::ADVANCE;
+	command.value = seconds;
+	send(std::move(command));
+}
+
+//****************************************************************************
+//
+// * The newest state moved on at its speed - but by no more than a couple
+//   of ticks, so a stalled simulation doesn't send the train off on its own
+//============================================================================
+float TrainSimulation::
+trainU()
+//============================================================================
+{
+	const TrainState& latest = states.read();
+	if (!threaded() || latest.velocity == 0.0f)
+		return latest.trainU;
+
+	const float tick = 1.0f / TICKS_PER_SECOND;
+	float age = std::chrono::duration<float>(std::chrono::steady_clock::now() - latest.stamp).count();
+	if (age < 0.0f)
+		age = 0.0f;
+	else if (age > 2.0f * tick)
+		age = 2.0f * tick;
+	return wrap(latest.trainU + latest.velocity * age, latest.maxU);
+}
+
+//****************************************************************************
+//
+// * Into the queue - or, with no thread, carried out right here. the queue
+//   only fills up if the thread is stuck, so waiting for room is fine
+//============================================================================
+void TrainSimulation::
+send(Command&& command)
+//============================================================================
+{
+	if (!threaded()) {
+		apply(command);
+		publish(0.0f);
+		return;
+	}
+	while (!commands.push(std::move(command)))
+		std::this_thread::yield();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrainSimulation::
+apply(const Command& command)
+//============================================================================
+{
+	switch (command.type) {
+		case Command::SETTINGS:
+			settings = command.settings;
+			break;
+		case Command::GEOMETRY:
+			geometry = command.geometry;
+			u = wrap(u, wrapLength(geometry.get()));
+			break;
+		case Command::PLACE:
+			u = wrap(command.value, wrapLength(geometry.get()));
+			break;
+		case Command::ADVANCE:
+			move(command.value);
+			break;
+	}
+}
+
+//****************************************************************************
+//
+// * What advanceTrain used to do: either a constant speed along the track
+//   (the arc length tables turn it into sleepers) or a fixed time for every
+//   control point segment
+//============================================================================
+float TrainSimulation::
+move(float seconds)
+//============================================================================
+{
+	if (seconds == 0.0f || !geometry || geometry->pointCount < 2 || geometry->segmentSleeperCounts.empty())
+		return 0.0f;
+	const float maxU = wrapLength(geometry.get());
+	if (maxU <= 0.0f)
+		return 0.0f;
+
+	const float direction = (seconds >= 0.0f) ? 1.0f : -1.0f;
+	const float dt = std::fabs(seconds);
+	const float sliderSpeed = settings.speed;
+	const float stepScale = 0.3f;
+	const float expectedUpdatesPerSecond = 30.0f;
+	const float baseArcSpeed = stepScale * expectedUpdatesPerSecond;
+	const float segmentDurationSeconds = 2.0f;
+	const float minSliderValue = 0.05f;
+
+	const std::vector<float>& segmentSampleCounts = geometry->segmentSleeperCounts;
+	const std::vector<float>& segmentArcLengths = geometry->segmentArcLengths;
+	const float averageSamplesPerSegment = geometry->averageSleepersPerSegment;
+	const float averageArcLengthPerSegment = geometry->averageArcLengthPerSegment;
+
+	int segmentIdx = segmentIndex();
+	if (segmentIdx < 0)
+		segmentIdx = 0;
+	else if (segmentIdx >= static_cast<int>(segmentSampleCounts.size()))
+		segmentIdx = static_cast<int>(segmentSampleCounts.size()) - 1;
+
+	float unitsPerSecond = 0.0f;
+	if (settings.arcLength) {
+		float samplesInSegment = segmentSampleCounts[segmentIdx];
+		float lengthInSegment = segmentArcLengths[segmentIdx];
+		if (samplesInSegment <= 1e-4f)
+			samplesInSegment = (averageSamplesPerSegment > 1e-4f) ? averageSamplesPerSegment : 1.0f;
+		if (lengthInSegment <= 1e-4f)
+			lengthInSegment = (averageArcLengthPerSegment > 1e-4f) ? averageArcLengthPerSegment : 1.0f;
+		float denomSamples = (samplesInSegment > 1.0f) ? samplesInSegment : 1.0f;
+		float denomAverageSamples = (averageSamplesPerSegment > 1.0f) ? averageSamplesPerSegment : 1.0f;
+		float lengthPerSample = lengthInSegment / denomSamples;
+		float averageLengthPerSample = averageArcLengthPerSegment / denomAverageSamples;
+		if (lengthPerSample <= 1e-4f)
+			lengthPerSample = averageLengthPerSample;
+		if (averageLengthPerSample <= 1e-4f)
+			averageLengthPerSample = 1.0f;
+		float effectiveSlider = (sliderSpeed > minSliderValue) ? sliderSpeed : minSliderValue;
+		float physicalSpeed = effectiveSlider * baseArcSpeed * averageLengthPerSample;
+		float safeLengthPerSample = (lengthPerSample > 1e-4f) ? lengthPerSample : 1e-4f;
+		unitsPerSecond = physicalSpeed / safeLengthPerSample;
+	} else {
+		// fixed time per control-point segment
+		float samplesInSegment = segmentSampleCounts[segmentIdx];
+		if (samplesInSegment <= 1e-4f)
+			samplesInSegment = averageSamplesPerSegment;
+		float duration = segmentDurationSeconds;
+		float speedFactor = (sliderSpeed > minSliderValue) ? sliderSpeed : minSliderValue;
+		duration /= speedFactor; // faster slider -> shorter duration
+		if (duration <= 1e-4f)
+			duration = segmentDurationSeconds;
+		unitsPerSecond = samplesInSegment / duration;
+	}
+
+	u = wrap(u + direction * unitsPerSecond * dt, maxU);
+	return direction * unitsPerSecond;
+}
+
+//****************************************************************************
+//
+// * The control point segment the train is on, from the spline parameter
+//   of the sleepers either side of it
+//============================================================================
+int TrainSimulation::
+segmentIndex() const
+//============================================================================
+{
+	const size_t segmentCount = geometry->pointCount;
+	if (segmentCount == 0)
+		return 0;
+
+	const auto& samples = geometry->sleepers;
+	if (samples.empty()) {
+		int segIdx = static_cast<int>(std::floor(u));
+		segIdx %= static_cast<int>(segmentCount);
+		if (segIdx < 0)
+			segIdx += static_cast<int>(segmentCount);
+		return segIdx;
+	}
+
+	const size_t sampleCount = samples.size();
+	double wrapped = std::fmod(static_cast<double>(u), static_cast<double>(sampleCount));
+	if (wrapped < 0.0)
+		wrapped += static_cast<double>(sampleCount);
+
+	const size_t idx0 = static_cast<size_t>(std::floor(wrapped)) % sampleCount;
+	const size_t idx1 = (idx0 + 1) % sampleCount;
+	const double localT = wrapped - std::floor(wrapped);
+
+	float param0 = samples[idx0].param;
+	float param1 = samples[idx1].param;
+	if (param1 < param0)
+		param1 += static_cast<float>(segmentCount);
+	float interpolated = param0 + (param1 - param0) * static_cast<float>(localT);
+
+	int segIdx = static_cast<int>(std::floor(interpolated));
+	segIdx %= static_cast<int>(segmentCount);
+	if (segIdx < 0)
+		segIdx += static_cast<int>(segmentCount);
+	return segIdx;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrainSimulation::
+publish(float velocity)
+//============================================================================
+{
+	TrainState& state = states.back();
+	state.trainU = u;
+	state.velocity = velocity;
+	state.maxU = wrapLength(geometry.get());
+	state.tick = ticks;
+	state.stamp = std::chrono::steady_clock::now();
+	states.publish();
+}
+
+//****************************************************************************
+//
+// * Fixed ticks against the clock: every tick that has come due since the
+//   last wake-up is run (up to MAX_CATCH_UP), then it sleeps till the next
+//============================================================================
+void TrainSimulation::
+run()
+//============================================================================
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration tick = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(1.0 / TICKS_PER_SECOND));
+	const float tickSeconds = 1.0f / TICKS_PER_SECOND;
+
+	Clock::time_point next = Clock::now();
+	while (!stopping.load(std::memory_order_relaxed)) {
+		Command command;
+		while (commands.pop(command))
+			apply(command);
+
+		const Clock::time_point now = Clock::now();
+		int due = 0;
+		while (next <= now && due < MAX_CATCH_UP) {
+			next += tick;
+			++due;
+		}
+		if (next <= now)
+			next = now + tick;
+
+		float velocity = 0.0f;
+		for (int i = 0; i < due; ++i) {
+			++ticks;
+			if (settings.running)
+				velocity = move(tickSeconds);
+		}
+		if (due > 0)
+			publish(velocity);
+
+		std::this_thread::sleep_until(next);
+	}
+}
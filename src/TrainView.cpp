@@ -27,12 +27,14 @@
 #include <algorithm>
 #include <ctime>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <Fl/fl.h>
 #include "GL/glu.h"
 
 #include "TrainView.H"
 #include "TrainWindow.H"
+#include "RenderThread.H"
 #include "Utilities/3DUtils.H"
 
 
@@ -45,36 +47,32 @@
 // * Shader
 //========================================================================
 #include "RenderUtilities/BufferObject.h";
+#include "RenderUtilities/ImmediateBatch.h"
 #include "RenderUtilities/Shader.h";
 #include "RenderUtilities/Texture.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <chrono>
+#include <thread>
+#include <unordered_map>
 
  float TrainView::startTime = std::chrono::duration<float>(std::chrono::system_clock::now().time_since_epoch()).count();
 
 #define M_PI 3.14159265359
 
 float TrainView::getTime() {
+    if (sceneTime >= 0.0f)
+        return sceneTime;
     static auto start = std::chrono::steady_clock::now();
     auto now = std::chrono::steady_clock::now();
     return std::chrono::duration<float>(now - start).count();  // seconds as float
 }
 
 void TrainView::setUBO() {
-	float wdt = this->pixel_w();
-	float hgt = this->pixel_h();
-
-	glm::mat4 view_matrix;
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-
-	glm::mat4 projection_matrix;
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
 	glBindBuffer(GL_UNIFORM_BUFFER, this->common_matrices->ubo);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &projection_matrix[0][0]);
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &view_matrix[0][0]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &currentView->camera.projection[0][0]);
+	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &currentView->camera.view[0][0]);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
@@ -84,7 +82,7 @@ void TrainView::setUBO() {
 //========================================================================
 TrainView::
 TrainView(int x, int y, int w, int h, const char* l) 
-	: Fl_Gl_Window(x,y,w,h,l)
+	: Fl_Gl_Window(x,y,w,h,l), builder(geometryReadyCB, this)
 //========================================================================
 {
 	mode( FL_RGB|FL_ALPHA|FL_DOUBLE | FL_STENCIL );
@@ -150,22 +148,27 @@ int TrainView::handle(int event)
 
 			// Compute the new control point position
 			if ((last_push == FL_LEFT_MOUSE) && (selectedCube >= 0)) {
-				ControlPoint* cp = &m_pTrack->points[selectedCube];
+				ControlPointRef cp = m_pTrack->points[selectedCube];
 
-				double r1x, r1y, r1z, r2x, r2y, r2z;
-				getMouseLine(r1x, r1y, r1z, r2x, r2y, r2z);
+				// the line under the mouse, out of the camera of the last
+				// packet - GL may be busy on the render thread
+				float x, y;
+				mouseInView(x, y);
+				glm::vec3 from, to;
+				cameraRay(camera, x, y, from, to);
 
 				double rx, ry, rz;
-				mousePoleGo(r1x, r1y, r1z, r2x, r2y, r2z, 
-								static_cast<double>(cp->pos.x), 
-								static_cast<double>(cp->pos.y),
-								static_cast<double>(cp->pos.z),
+				mousePoleGo(from.x, from.y, from.z, to.x, to.y, to.z,
+								static_cast<double>(cp.pos.x), 
+								static_cast<double>(cp.pos.y),
+								static_cast<double>(cp.pos.z),
 								rx, ry, rz,
 								(Fl::event_state() & FL_CTRL) != 0);
 
-				cp->pos.x = (float) rx;
-				cp->pos.y = (float) ry;
-				cp->pos.z = (float) rz;
+				cp.pos.x = (float) rx;
+				cp.pos.y = (float) ry;
+				cp.pos.z = (float) rz;
+				m_pTrack->markChanged();
 				damage(1);
 			}
 			break;
@@ -198,6 +201,17 @@ int TrainView::handle(int event)
 
 					return 1;
 				};
+				if (k == 'm') {
+					showOverlay = !showOverlay;
+					damage(1);
+					return 1;
+				}
+				if (k == 'd') {
+					// the overlay's numbers belong to whoever draws
+					dumpResources = true;
+					damage(1);
+					return 1;
+				}
 				break;
 	}
 
@@ -207,9 +221,113 @@ int TrainView::handle(int event)
 //************************************************************************
 //
 // * this is the code that actually draws the window
-//   it puts a lot of the work into other routines to simplify things
+//   the widgets and the track go into a packet, and render() draws that
 //========================================================================
 void TrainView::draw()
+{
+	render(*makePacket(false));
+}
+
+//************************************************************************
+//
+// * FLTK calls this to redraw the window. with the render thread going,
+//   the frame is drawn and swapped over there - all that is left here is
+//   to tell it what to draw
+//========================================================================
+void TrainView::flush()
+{
+	if (renderThread && renderThread->running()) {
+		renderThread->post(makePacket(true));
+		return;
+	}
+	Fl_Gl_Window::flush();
+}
+
+//************************************************************************
+//
+// * FLTK deletes the context when the window goes - it has to be back on
+//   this thread by then
+//========================================================================
+void TrainView::hide()
+{
+	stopRenderThread();
+	Fl_Gl_Window::hide();
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void TrainView::startRenderThread()
+{
+	if (!renderThread)
+		renderThread = new RenderThread(*this);
+	renderThread->start();
+	redraw();
+}
+
+void TrainView::stopRenderThread()
+{
+	if (!renderThread)
+		return;
+	delete renderThread;
+	renderThread = nullptr;
+}
+
+//************************************************************************
+//
+// * Everything the next frame is drawn from. this is the only place the
+//   drawing looks at the widgets and the track; the geometry builds and
+//   the cab camera are moved along here too, on the UI thread
+//========================================================================
+std::shared_ptr<FramePacket> TrainView::makePacket(bool snapshot)
+{
+	std::shared_ptr<FramePacket> frame = std::make_shared<FramePacket>();
+	frame->number = ++packetCount;
+	frame->width = w();
+	frame->height = h();
+	frame->time = getTime();
+
+	// where the simulation has the train right now
+	if (tw && m_pTrack)
+		m_pTrack->trainU = tw->simulation.trainU();
+
+	updateGeometry();
+	frame->geometry = geometry;
+
+	frame->shaderChoice = tw->shaderBrowser->value();
+	frame->lightChoice = tw->lightBrowser->value();
+	frame->running = tw->runButton->value() != 0;
+	makeViews(*frame);
+	frame->showOverlay = showOverlay;
+	frame->dumpResources = dumpResources;
+	dumpResources = false;
+
+	frame->revision = m_pTrack->revision;
+	frame->selectedCube = selectedCube;
+	frame->trainU = m_pTrack->trainU;
+	if (snapshot) {
+		// the copy shares the list's chunks - an edit after it copies the
+		// one chunk it changes, so a drag doesn't copy the track each step
+		if (!pointsSnapshot || snapshotRevision != m_pTrack->revision) {
+			pointsSnapshot = std::make_shared<const ControlPointList>(m_pTrack->points);
+			snapshotRevision = m_pTrack->revision;
+		}
+		frame->points = pointsSnapshot;
+	}
+	else {
+		// drawn before this returns to the event loop - no copy needed
+		pointsSnapshot.reset();
+		frame->points = std::shared_ptr<const ControlPointList>(std::shared_ptr<void>(), &m_pTrack->points);
+	}
+	return frame;
+}
+
+//************************************************************************
+//
+// * Draw a frame, from the packet alone
+//========================================================================
+void TrainView::render(const FramePacket& frame)
 {
 
 	//*********************************************************************
@@ -217,39 +335,97 @@ void TrainView::draw()
 	// * Set up basic opengl informaiton
 	//
 	//**********************************************************************
-	//initialized glad
-	
-	if (gladLoadGL())
-	{
-		int shaderChoice = tw->shaderBrowser->value();
-		if(shaderChoice == 1)
-			setCastle();
-		else if(shaderChoice == 2) {
-			setColoredCastle();
-		}
-		else if (shaderChoice == 3) {
-			setWave(getTime());
-		}
-		else if (shaderChoice == 4) {
-			setWaveSine(getTime());
-		}
-	}
-	else
+	// glad only has to be loaded once, and not here at all if main's
+	// headless mode made the context and loaded it through EGL
+	if (!GLAD_GL_VERSION_1_0 && !gladLoadGL())
 		throw std::runtime_error("Could not initialize GLAD!");
 
-	
-	
+	// whatever the last frame put in the arena is done with
+	frameArena.reset();
+	packet = &frame;
 
-	// Set up the view port
-	glViewport(0,0,w(),h());
+	int shaderChoice = frame.shaderChoice;
+	if(shaderChoice == 1)
+		setCastle();
+	else if(shaderChoice == 2) {
+		setColoredCastle();
+	}
+	else if (shaderChoice == 3) {
+		setWave(frame.time);
+	}
+	else if (shaderChoice == 4) {
+		setWaveSine(frame.time);
+	}
+	else if (shaderChoice == 5) {
+		setWaveGerstner(frame.time);
+	}
+	else if (shaderChoice == 6) {
+		setOcean(frame.time);
+	}
 
-	// clear the window, be sure to clear the Z-Buffer too
-	glClearColor(0,0,.3f,0);		// background should be blue
+	// the water moves once a frame, however many views draw it
+	animateWater();
+
+	// the window - or the exporter's framebuffer, if it bound one
+	GLint window = 0;
+	if (frame.views.size() > 1)
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window);
 
+	// clear the window, be sure to clear the Z-Buffer too
 	// we need to clear out the stencil buffer since we'll use
 	// it for shadows
+	glViewport(0,0,frame.width,frame.height);
+	glClearColor(0,0,.3f,0);		// background should be blue
 	glClearStencil(0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+	size_t side = 0;
+	for (const ViewPacket& view : frame.views) {
+		if (!view.offscreen) {
+			renderView(view);
+			continue;
+		}
+
+		// a side view goes into its own framebuffer, drawn only when the
+		// packet asks (or the buffers are new), and put up every frame
+		if (side == sideTargets.size())
+			sideTargets.emplace_back(new RenderTarget("TrainView side view"));
+		RenderTarget& target = *sideTargets[side++];
+		const bool fresh = !target.matches(view.width, view.height);
+		if (!target.resize(view.width, view.height)) {
+			renderView(view);
+			continue;
+		}
+		if (view.redraw || fresh) {
+			target.bind();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			ViewPacket inTarget = view;
+			inTarget.x = inTarget.y = 0;
+			renderView(inTarget);
+			glBindFramebuffer(GL_FRAMEBUFFER, window);
+		}
+		target.blit(window, view.x, view.y);
+	}
+	// not split any more - let the buffers go
+	sideTargets.resize(side);
+
+	glViewport(0,0,frame.width,frame.height);
+	drawOverlay();
+	packet = nullptr;
+}
+
+//************************************************************************
+//
+// * One camera's view of the frame, into the part of the framebuffer
+//   view says. everything it draws was uploaded once for the frame -
+//   the floor, the rails and the shaders' buffers are the same for every
+//   view, only the camera is new
+//========================================================================
+void TrainView::renderView(const ViewPacket& view)
+{
+	currentView = &view;
+	glViewport(view.x, view.y, view.width, view.height);
+
 	// ensure depth testing is enabled (GL_DEPTH is invalid enum)
 	glEnable(GL_DEPTH_TEST);
 
@@ -259,7 +435,15 @@ void TrainView::draw()
 	// prepare for projection
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	setProjection();		// put the code to set up matrices here
+	loadCamera(view.camera);
+
+	// the core-profile path lights and draws everything its own way
+	if (backend == BACKEND_CORE) {
+		drawCore();
+		useShader(packet->shaderChoice);
+		currentView = nullptr;
+		return;
+	}
 
 	//######################################################################
 	// TODO: 
@@ -274,12 +458,12 @@ void TrainView::draw()
 	glEnable(GL_NORMALIZE);
 
 	// top view only needs one light
-	if (tw->topCam->value()) {
+	if (view.topCam) {
 		glDisable(GL_LIGHT1);
 		glDisable(GL_LIGHT2);
 	} 
 
-	switch (tw->lightBrowser->value()) {
+	switch (packet->lightChoice) {
 	case 1:
 	case 2:
 		glDisable(GL_LIGHT3);
@@ -325,7 +509,7 @@ void TrainView::draw()
 	glMatrixMode(GL_MODELVIEW);
 
 	// directional light
-	if (tw->lightBrowser->value() == 2) {
+	if (packet->lightChoice == 2) {
 		float noAmbient[] = { 0.0f, 0.0f, 0.0f, 1.0f };
 		float whiteDiffuse[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 		float position[] = { 1.0f, 1.0f, 0.0f, 0.0f };
@@ -333,7 +517,7 @@ void TrainView::draw()
 		glLightfv(GL_LIGHT0, GL_DIFFUSE, whiteDiffuse);
 		glLightfv(GL_LIGHT0, GL_POSITION, position);
 	}
-	else if (tw->lightBrowser->value() == 3) {
+	else if (packet->lightChoice == 3) {
 
 		// spot-light parameters will be set later (after the modelview/camera
 		// transform is established) so the position/direction are in the
@@ -375,7 +559,7 @@ void TrainView::draw()
 	glUseProgram(0);
 
 	setupFloor();
-	if (tw->lightBrowser->value() == 1) {
+	if (packet->lightChoice == 1) {
 		glDisable(GL_LIGHTING);
 	}
 	drawFloor(200,10);
@@ -391,63 +575,165 @@ void TrainView::draw()
 	drawStuff();
 
 	// this time drawing is for shadows (except for top view)
-	if (!tw->topCam->value()) {
+	if (!view.topCam) {
 		setupShadows();
 		drawStuff(true);
 		unsetupShadows();
 	}
 	
-	useShader(tw->shaderBrowser->value());
-	
+	useShader(packet->shaderChoice);
+	currentView = nullptr;
+}
+
+//************************************************************************
+//
+// * Count what the frame left behind - every frame, so the deltas are
+//   per frame whether the overlay is up or not
+//========================================================================
+void TrainView::drawOverlay()
+{
+	overlay.setHeap("control points", packet->points ? packet->points->memoryUsed() : 0);
+	overlay.setHeap("track geometry", packet->geometry ? packet->geometry->memoryUsed() : 0);
+	overlay.setHeap("frame arena", frameArena.stats().capacity);
+	overlay.setHeap("ocean", ocean ? ocean->memoryUsed() : 0);
+	overlay.setHeap("immediate batch", ImmediateBatch::instance().memoryUsed());
+	overlay.update();
+
+	if (packet->dumpResources)
+		overlay.report(stdout);
+	if (packet->showOverlay)
+		overlay.draw(packet->width, packet->height);
 }
 
 
 //************************************************************************
 //
-// * This sets up both the Projection and the ModelView matrices
-//   HOWEVER: it doesn't clear the projection first (the caller handles
-//   that) - its important for picking
+// * This works out both the Projection and the ModelView matrices of one
+//   of the cameras - render() loads them into GL from the packet
 //========================================================================
-void TrainView::
-setProjection()
+CameraMatrices TrainView::
+cameraFor(CameraChoice which, float aspect)
 //========================================================================
 {
-	// Compute the aspect ratio (we'll need it)
-	float aspect = static_cast<float>(w()) / static_cast<float>(h());
-
+	CameraMatrices matrices;
 	// Check whether we use the world camp
-	if (tw->worldCam->value())
-		arcball.setProjection(false);
+	if (which == CAMERA_WORLD)
+		matrices = worldCamera(arcball, aspect);
 	// Or we use the top cam
-	else if (tw->topCam->value()) {
-		float wi, he;
-		if (aspect >= 1) {
-			wi = 110;
-			he = wi / aspect;
-		} 
-		else {
-			he = 110;
-			wi = he * aspect;
-		}
-
-		// Set up the top camera drop mode to be orthogonal and set
-		// up proper projection matrix
-		glMatrixMode(GL_PROJECTION);
-		glOrtho(-wi, wi, -he, he, 200, -200);
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-		glRotatef(-90,1,0,0);
-	} 
+	else if (which == CAMERA_TOP)
+		matrices = topCamera(aspect);
 	// Or do the train view or other view here
-	//####################################################################
-	// TODO: 
-	// put code for train view projection here!	
-	//####################################################################
 	else {
 #ifdef EXAMPLE_SOLUTION
 		trainCamView(this,aspect);
+		glGetFloatv(GL_MODELVIEW_MATRIX, &matrices.view[0][0]);
+		glGetFloatv(GL_PROJECTION_MATRIX, &matrices.projection[0][0]);
+#else
+		// with no track to ride on yet, fall back to the world camera
+		const float fov = static_cast<float>(tw->cabFov->value());
+		if (!geometry || !m_pTrack
+			|| !cab.update(matrices, *geometry, m_pTrack->trainU, fov, aspect, getTime()))
+			matrices = worldCamera(arcball, aspect);
 #endif
 	}
+	return matrices;
+}
+
+//************************************************************************
+//
+// * The camera the radio buttons pick
+//========================================================================
+TrainView::CameraChoice TrainView::
+selectedCamera() const
+//========================================================================
+{
+	if (tw->topCam->value())
+		return CAMERA_TOP;
+	if (tw->trainCam->value())
+		return CAMERA_TRAIN;
+	return CAMERA_WORLD;
+}
+
+//************************************************************************
+//
+// * Where view index goes in the window, GL's way up. split, the main
+//   view takes the left two thirds and the side views share the rest,
+//   one above the other
+//========================================================================
+void TrainView::
+viewRect(bool split, size_t index, int& x, int& y, int& width, int& height) const
+//========================================================================
+{
+	const int sideWidth = split ? w() / 3 : 0;
+	if (index == 0) {
+		x = 0;
+		y = 0;
+		width = w() - sideWidth;
+		height = h();
+		return;
+	}
+	x = w() - sideWidth;
+	width = sideWidth;
+	height = (index == 1) ? h() / 2 : h() - h() / 2;
+	y = (index == 1) ? h() - height : 0;
+}
+
+//************************************************************************
+//
+// * The mouse in the main view, -1..1 like clip space x and y - false
+//   if it is off to the side
+//========================================================================
+bool TrainView::
+mouseInView(float& x, float& y) const
+//========================================================================
+{
+	int vx, vy, vw, vh;
+	viewRect(split, 0, vx, vy, vw, vh);
+	x = 2.0f * (Fl::event_x() - vx) / vw - 1.0f;
+	y = 2.0f * ((h() - Fl::event_y()) - vy) / vh - 1.0f;
+	return x >= -1.0f && x <= 1.0f && y >= -1.0f && y <= 1.0f;
+}
+
+//************************************************************************
+//
+// * The views of the next packet: the camera the radio buttons pick, and
+//   with the split button the other two. the side views are drawn again
+//   only every SIDE_VIEW_INTERVAL frames while the train runs, so they
+//   cost a fraction of the main view; otherwise frames only come with
+//   events, and every one of them is drawn in full
+//========================================================================
+void TrainView::
+makeViews(FramePacket& frame)
+//========================================================================
+{
+	split = tw->splitViews && tw->splitViews->value();
+
+	CameraChoice order[3] = { selectedCamera(), CAMERA_WORLD, CAMERA_WORLD };
+	size_t count = 1;
+	if (split)
+		for (CameraChoice other : { CAMERA_WORLD, CAMERA_TRAIN, CAMERA_TOP })
+			if (other != order[0])
+				order[count++] = other;
+
+	bool cabShown = false;
+	const bool sideRedraw = !frame.running || frame.number % SIDE_VIEW_INTERVAL == 0;
+	frame.views.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		ViewPacket& view = frame.views[i];
+		viewRect(split, i, view.x, view.y, view.width, view.height);
+		const float aspect = static_cast<float>(view.width) / static_cast<float>(std::max(view.height, 1));
+		view.camera = cameraFor(order[i], aspect);
+		view.topCam = order[i] == CAMERA_TOP;
+		view.trainCam = order[i] == CAMERA_TRAIN;
+		view.offscreen = i > 0;
+		view.redraw = i == 0 || sideRedraw;
+		cabShown = cabShown || view.trainCam;
+	}
+	if (!cabShown)
+		cab.reset();
+
+	// picking goes by the main view
+	camera = frame.views[0].camera;
 }
 
 //************************************************************************
@@ -467,75 +753,31 @@ void TrainView::drawStuff(bool doingShadows)
 	// Draw the control points
 	// don't draw the control points if you're driving 
 	// (otherwise you get sea-sick as you drive through them)
-	if (!tw->trainCam->value()) {
-		for(size_t i=0; i<m_pTrack->points.size(); ++i) {
-			if (!doingShadows) {
-				if ( ((int) i) != selectedCube)
-					glColor3ub(240, 60, 60);
-				else
-					glColor3ub(240, 240, 30);
-			}
-			m_pTrack->points[i].draw();
-		}
-	}
-	// draw the track
-	//####################################################################
-	// TODO: 
-	// // Draw the control points
-    // don't draw the control points if you're driving 
-    // (otherwise you get sea-sick as you drive through them)
-	if (!tw->trainCam->value()) {
-		for (size_t i = 0; i < m_pTrack->points.size(); ++i) {
-			if (!doingShadows) {
-				if (((int)i) != selectedCube)
-					glColor3ub(240, 60, 60);
-				else
-					glColor3ub(240, 240, 30);
-			}
-			m_pTrack->points[i].draw();
-		}
+	// they are one instanced draw, the same one the core-profile path
+	// makes - the shadow pass keeps the stencil setupShadows made
+	if (!currentView->trainCam) {
+		if (!core)
+			core = new CoreRenderer();
+		core->beginFrame(currentView->camera, packet->lightChoice);
+		core->setShadowPass(doingShadows);
+		core->drawControlPoints(*packet->points, packet->revision, packet->selectedCube);
+		core->setShadowPass(false);
+		glUseProgram(0);
 	}
 	// draw the track
 	//####################################################################
-	int shaderChoice = tw->shaderBrowser->value();
-	if(shaderChoice == 3 && tw->runButton->value() == true)
-		updateWater(getTime(), 100, 100.0f);
-	else if (shaderChoice == 4 && tw->runButton->value() == true)
-		updateSine(getTime());
-
 	drawTrack(doingShadows);
 	drawSleepers(doingShadows);
 
 	/*
 	// Train-attached spotlight (disabled per user request).
 	// If you want to enable it again, remove the surrounding comment block.
-	if (!doingShadows && tw->lightBrowser->value() == 3) {
-		if (!sleeperSamples.empty() && m_pTrack) {
-			const size_t count = sleeperSamples.size();
-			float u = m_pTrack->trainU;
-			float total = static_cast<float>(count);
-			if (total > 0.0f) {
-				u = std::fmod(u, total);
-				if (u < 0.0f) u += total;
-			} else u = 0.0f;
-			size_t idx0 = static_cast<size_t>(std::floor(u));
-			if (idx0 >= count) idx0 = count - 1;
-			size_t idx1 = (idx0 + 1) % count;
-			float interp = (count > 1) ? (u - static_cast<float>(idx0)) : 0.0f;
-			const SplineSample &s0 = sleeperSamples[idx0];
-			const SplineSample &s1 = sleeperSamples[idx1];
-			Pnt3f pos = (count > 1) ? lerp(s0.pos, s1.pos, interp) : s0.pos;
-			Pnt3f up = (count > 1) ? normalizeVector(lerp(s0.orient, s1.orient, interp)) : normalizeVector(s0.orient);
-			Pnt3f forward = (count > 1) ? normalizeVector(lerp(s0.tangent, s1.tangent, interp)) : normalizeVector(s0.tangent);
-			if (lengthSquared(up) < 1e-6f) up = Pnt3f(0.0f, 1.0f, 0.0f);
-			if (lengthSquared(forward) < 1e-6f) forward = Pnt3f(0.0f, 0.0f, 1.0f);
-			forward.normalize(); up.normalize();
-			Pnt3f right = forward * up;
-			if (lengthSquared(right) < 1e-6f) {
-				up = Pnt3f(0.0f, 1.0f, 0.0f);
-				right = forward * up;
-			}
-			right.normalize(); up = right * forward; up.normalize();
+	if (!doingShadows && packet->lightChoice == 3) {
+		if (packet->geometry && !packet->geometry->sleepers.empty() && m_pTrack) {
+			const TrackFrame frame = packet->geometry->trainFrame(packet->trainU);
+			const Pnt3f pos = frame.pos;
+			const Pnt3f up = frame.up();
+			const Pnt3f forward = frame.forward();
 
 			const float halfSize = 3.0f;
 			const Pnt3f cubeCenter = pos + up * halfSize; // same as drawTrain
@@ -564,7 +806,7 @@ void TrainView::drawStuff(bool doingShadows)
 	*/
 	// call your own track drawing code
 	//####################################################################
-	if (!tw->trainCam->value())
+	if (!currentView->trainCam)
 		drawTrain(doingShadows);
 
 #ifdef EXAMPLE_SOLUTION
@@ -577,94 +819,84 @@ void TrainView::drawStuff(bool doingShadows)
 	//####################################################################
 #ifdef EXAMPLE_SOLUTION
 	// don't draw the train if you're looking out the front window
-	if (!tw->trainCam->value())
+	if (!currentView->trainCam)
 		drawTrain(this, doingShadows);
 #endif
 }
 
-size_t TrainView::wrapIndex(int idx, size_t count) const
+//************************************************************************
+//
+// * Move the water along (if the train is running) - once a frame, before
+//   any view is drawn
+//========================================================================
+void TrainView::animateWater()
 {
-	if (count == 0)
-		return 0;
-	int mod = idx % static_cast<int>(count);
-	if (mod < 0)
-		mod += static_cast<int>(count);
-	return static_cast<size_t>(mod);
+	int shaderChoice = packet->shaderChoice;
+	if(shaderChoice == 3 && packet->running)
+		updateWater(packet->time, 100, 100.0f);
+	else if (shaderChoice == 4 && packet->running)
+		updateSine(packet->time);
+	else if (shaderChoice == 5 && packet->running)
+		updateGerstner(packet->time);
+	else if (shaderChoice == 6 && packet->running)
+		updateOcean(packet->time);
 }
 
-Pnt3f TrainView::lerp(const Pnt3f& a, const Pnt3f& b, float t) const
+//************************************************************************
+//
+// * The core-profile version of the rest of draw() - the same floor,
+//   objects and shadows, all through the CoreRenderer
+//========================================================================
+void TrainView::drawCore()
 {
-	return a * (1.0f - t) + b * t;
-}
+	if (!core)
+		core = new CoreRenderer();
 
-float TrainView::lengthSquared(const Pnt3f& v) const
-{
-	return v.x * v.x + v.y * v.y + v.z * v.z;
-}
+	const int lighting = packet->lightChoice;
+	core->beginFrame(currentView->camera, lighting);
 
-Pnt3f TrainView::normalizeVector(const Pnt3f& v) const
-{
-	Pnt3f copy = v;
-	copy.normalize();
-	return copy;
-}
+	setupFloor();
+	core->drawFloor(lighting != CoreRenderer::LIGHTS_NORMAL);
+	setupObjects();
 
-float TrainView::distanceBetween(const Pnt3f& a, const Pnt3f& b) const
-{
-	return std::sqrt(lengthSquared(b - a));
-}
+	drawCoreStuff(false);
 
-void TrainView::cardinalWeights(float t, float weights[4]) const
-{
-	const float t2 = t * t;
-	const float t3 = t2 * t;
-	weights[0] = -0.5f * t3 + t2 - 0.5f * t;
-	weights[1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
-	weights[2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
-	weights[3] = 0.5f * t3 - 0.5f * t2;
+	// this time drawing is for shadows (except for top view)
+	if (!currentView->topCam) {
+		core->beginShadows();
+		drawCoreStuff(true);
+		core->endShadows();
+	}
+	glUseProgram(0);
 }
 
-void TrainView::cardinalDerivatives(float t, float deriv[4]) const
+//************************************************************************
+//
+// * drawStuff for the core-profile path
+//========================================================================
+void TrainView::drawCoreStuff(bool doingShadows)
 {
-	const float t2 = t * t;
-	deriv[0] = -1.5f * t2 + 2.0f * t - 0.5f;
-	deriv[1] = 4.5f * t2 - 5.0f * t;
-	deriv[2] = -4.5f * t2 + 4.0f * t + 0.5f;
-	deriv[3] = 1.5f * t2 - t;
-}
+	// don't draw the control points if you're driving
+	if (!currentView->trainCam) {
+		core->drawControlPoints(*packet->points, packet->revision, packet->selectedCube);
+	}
 
-void TrainView::bsplineWeights(float t, float weights[4]) const
-{
-	const float t2 = t * t;
-	const float t3 = t2 * t;
-	weights[0] = (-t3 + 3.0f * t2 - 3.0f * t + 1.0f) / 6.0f;
-	weights[1] = (3.0f * t3 - 6.0f * t2 + 4.0f) / 6.0f;
-	weights[2] = (-3.0f * t3 + 3.0f * t2 + 3.0f * t + 1.0f) / 6.0f;
-	weights[3] = t3 / 6.0f;
-}
+	// the rails - the shadow pass draws the chunks that are off screen too
+	updateRailBuffers();
+	Frustum frustum(currentView->camera.projection * currentView->camera.view);
+	for (const RailChunkBuffers& buffers : railBuffers) {
+		const RailChunk& chunk = *buffers.chunk;
+		if (chunk.indices.empty())
+			continue;
+		if (!doingShadows && !frustum.intersects(chunk.boundsMin, chunk.boundsMax))
+			continue;
+		core->drawRailChunk(buffers.vbo, buffers.ebo, static_cast<GLsizei>(chunk.indices.size()));
+	}
 
-void TrainView::bsplineDerivatives(float t, float deriv[4]) const
-{
-	const float t2 = t * t;
-	deriv[0] = (-3.0f * t2 + 6.0f * t - 3.0f) / 6.0f;
-	deriv[1] = (9.0f * t2 - 12.0f * t) / 6.0f;
-	deriv[2] = (-9.0f * t2 + 6.0f * t + 3.0f) / 6.0f;
-	deriv[3] = (3.0f * t2) / 6.0f;
-}
+	core->drawSleepers(packet->geometry);
 
-Pnt3f TrainView::railOffset(const Pnt3f& dir, const Pnt3f& up, float halfWidth) const
-{
-	Pnt3f side = dir * up;
-	if (lengthSquared(side) < 1e-6f) {
-		const Pnt3f fallbackUp(0.0f, 1.0f, 0.0f);
-		side = dir * fallbackUp;
-		if (lengthSquared(side) < 1e-6f) {
-			const Pnt3f fallbackUp2(0.0f, 0.0f, 1.0f);
-			side = dir * fallbackUp2;
-		}
-	}
-	side.normalize();
-	return side * halfWidth;
+	if (!currentView->trainCam && packet->geometry && !packet->geometry->sleepers.empty())
+		core->drawTrain(packet->geometry->trainFrame(packet->trainU));
 }
 
 Pnt3f TrainView::orientPoint(const Pnt3f& origin, const Pnt3f& right, const Pnt3f& up, const Pnt3f& forward, float x, float y, float z) const
@@ -672,190 +904,175 @@ Pnt3f TrainView::orientPoint(const Pnt3f& origin, const Pnt3f& right, const Pnt3
 	return origin + right * x + up * y + forward * z;
 }
 
+//************************************************************************
+//
+// * The rails - one indexed draw per chunk that is in view
+//   the shadow pass flattens everything onto the floor, so a chunk that
+//   is off screen can still have its shadow on screen - that pass draws
+//   them all
+//========================================================================
 void TrainView::drawTrack(bool doingShadows)
 {
-	if (!m_pTrack || m_pTrack->points.size() < 2)
+	updateRailBuffers();
+	if (railBuffers.empty())
 		return;
 
-	const int splineChoice = currentSplineChoice();
-	const size_t pointCount = m_pTrack->points.size();
-	const int stepsPerSegment = (DIVIDE_LINE < 1.0f) ? 1 : static_cast<int>(DIVIDE_LINE);
-	const float invSteps = 1.0f / static_cast<float>(stepsPerSegment);
-	const float trackHalfWidth = 2.5f;
-
-	if (!doingShadows)
+	Frustum frustum;
+	if (!doingShadows) {
 		glColor3ub(32, 32, 64);
-	glLineWidth(3.0f);
-
-	for (size_t segIdx = 0; segIdx < pointCount; ++segIdx) {
-		const float baseU = static_cast<float>(segIdx);
-		for (int step = 0; step < stepsPerSegment; ++step) {
-			const float u0 = baseU + step * invSteps;
-			const float u1 = baseU + (step + 1) * invSteps;
-			const SplineSample sample0 = sampleSpline(u0, splineChoice);
-			const SplineSample sample1 = sampleSpline(u1, splineChoice);
-			Pnt3f dir = sample1.pos - sample0.pos;
-			if (lengthSquared(dir) < 1e-6f)
-				continue;
-			dir.normalize();
-			const Pnt3f offset0 = railOffset(dir, sample0.orient, trackHalfWidth);
-			const Pnt3f offset1 = railOffset(dir, sample1.orient, trackHalfWidth);
-
-			glBegin(GL_LINES);
-			glVertex3f(sample0.pos.x + offset0.x, sample0.pos.y + offset0.y, sample0.pos.z + offset0.z);
-			glVertex3f(sample1.pos.x + offset1.x, sample1.pos.y + offset1.y, sample1.pos.z + offset1.z);
-			glVertex3f(sample0.pos.x - offset0.x, sample0.pos.y - offset0.y, sample0.pos.z - offset0.z);
-			glVertex3f(sample1.pos.x - offset1.x, sample1.pos.y - offset1.y, sample1.pos.z - offset1.z);
-			glEnd();
+		frustum.set(currentView->camera.projection * currentView->camera.view);
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	for (const RailChunkBuffers& buffers : railBuffers) {
+		const RailChunk& chunk = *buffers.chunk;
+		if (chunk.indices.empty())
+			continue;
+		if (!doingShadows && !frustum.intersects(chunk.boundsMin, chunk.boundsMax))
+			continue;
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+		glVertexPointer(3, GL_FLOAT, 6 * sizeof(GLfloat), (GLvoid*)0);
+		glNormalPointer(GL_FLOAT, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo);
+		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(chunk.indices.size()), GL_UNSIGNED_INT, (GLvoid*)0);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+//************************************************************************
+//
+// * Make the rail buffers match the chunks of the geometry being drawn
+//   chunks carried over from the last build keep their buffers, only the
+//   new ones are uploaded, and the buffers of the chunks that are gone
+//   are deleted
+//========================================================================
+void TrainView::updateRailBuffers()
+{
+	static const std::vector<std::shared_ptr<const RailChunk>> none;
+	const std::vector<std::shared_ptr<const RailChunk>>& chunks = packet->geometry ? packet->geometry->railChunks : none;
+
+	bool same = chunks.size() == railBuffers.size();
+	for (size_t i = 0; same && i < chunks.size(); ++i)
+		same = chunks[i] == railBuffers[i].chunk;
+	if (same)
+		return;
+
+	std::unordered_map<const RailChunk*, RailChunkBuffers> old;
+	for (RailChunkBuffers& buffers : railBuffers)
+		old[buffers.chunk.get()] = buffers;
+
+	std::vector<RailChunkBuffers> updated(chunks.size());
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		auto found = old.find(chunks[i].get());
+		if (found != old.end()) {
+			updated[i] = found->second;
+			old.erase(found);
+			continue;
 		}
+
+		RailChunkBuffers& buffers = updated[i];
+		buffers.chunk = chunks[i];
+		genBuffers(1, &buffers.vbo, "TrainView rails");
+		genBuffers(1, &buffers.ebo, "TrainView rails");
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+		bufferData(GL_ARRAY_BUFFER, buffers.vbo, chunks[i]->vertices.size() * sizeof(GLfloat),
+				   chunks[i]->vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo);
+		bufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo, chunks[i]->indices.size() * sizeof(GLuint),
+				   chunks[i]->indices.data(), GL_STATIC_DRAW);
 	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (auto& leftover : old) {
+		deleteBuffers(1, &leftover.second.vbo);
+		deleteBuffers(1, &leftover.second.ebo);
+	}
+	railBuffers.swap(updated);
 }
 
 void TrainView::drawSleepers(bool doingShadows)
 {
-	if (!m_pTrack || m_pTrack->points.size() < 2)
+	if (!packet->geometry || packet->geometry->sleeperVertices.empty())
 		return;
 
-	const int splineChoice = currentSplineChoice();
-	const size_t pointCount = m_pTrack->points.size();
-	const int stepsPerSegment = (DIVIDE_LINE < 1.0f) ? 1 : static_cast<int>(DIVIDE_LINE);
-	const float invSteps = 1.0f / static_cast<float>(stepsPerSegment);
-	const float sleeperSpacing = 8.0f;
-	const float sleeperHalfWidth = 3.0f;
-	const float sleeperHalfLength = 2.0f;
-	const float halfStep = invSteps * 0.5f;
-	const float tangentSampleOffset = (halfStep > 0.01f) ? halfStep : 0.01f;
-
-	sleeperSamples.clear();
-
-	float distSinceLastSleeper = 0.0f;
-
-	for (size_t segIdx = 0; segIdx < pointCount; ++segIdx) {
-		const float baseU = static_cast<float>(segIdx);
-		for (int step = 0; step < stepsPerSegment; ++step) {
-			const float u0 = baseU + step * invSteps;
-			const float u1 = baseU + (step + 1) * invSteps;
-			SplineSample startSample = sampleSpline(u0, splineChoice);
-			const SplineSample endSample = sampleSpline(u1, splineChoice);
-			float segmentLength = distanceBetween(startSample.pos, endSample.pos);
-			if (segmentLength < 1e-5f)
-				continue;
+	if (!doingShadows)
+		glColor3ub(255, 255, 255);
 
-			float currentU = u0;
-			while (distSinceLastSleeper + segmentLength >= sleeperSpacing) {
-				const float needed = sleeperSpacing - distSinceLastSleeper;
-				float ratio = needed / segmentLength;
-				if (ratio < 0.0f) ratio = 0.0f;
-				if (ratio > 1.0f) ratio = 1.0f;
-				const float sleeperU = currentU + (u1 - currentU) * ratio;
-				const SplineSample sleeperSample = sampleSpline(sleeperU, splineChoice);
-				SplineSample aheadSample = sampleSpline(sleeperU + tangentSampleOffset, splineChoice);
-				Pnt3f tangent = aheadSample.pos - sleeperSample.pos;
-				if (lengthSquared(tangent) < 1e-6f) {
-					SplineSample behindSample = sampleSpline(sleeperU - tangentSampleOffset, splineChoice);
-					tangent = sleeperSample.pos - behindSample.pos;
-				}
-				if (lengthSquared(tangent) < 1e-6f)
-					tangent = endSample.pos - startSample.pos;
-				tangent.normalize();
-
-				const Pnt3f right = railOffset(tangent, sleeperSample.orient, sleeperHalfWidth);
-				const Pnt3f forward = tangent * sleeperHalfLength;
-				const Pnt3f center = sleeperSample.pos;
-
-				SplineSample storedSleeper = sleeperSample;
-				storedSleeper.tangent = tangent;
-				storedSleeper.param = sleeperU;
-				sleeperSamples.push_back(storedSleeper);
-
-				glBegin(GL_QUADS);
-				if (!doingShadows)
-					glColor3ub(255, 255, 255);
-				Pnt3f normal = normalizeVector(sleeperSample.orient);
-				glNormal3f(normal.x, normal.y, normal.z);
-				const Pnt3f v0 = center - forward - right;
-				const Pnt3f v1 = center - forward + right;
-				const Pnt3f v2 = center + forward + right;
-				const Pnt3f v3 = center + forward - right;
-				glVertex3f(v0.x, v0.y, v0.z);
-				glVertex3f(v1.x, v1.y, v1.z);
-				glVertex3f(v2.x, v2.y, v2.z);
-				glVertex3f(v3.x, v3.y, v3.z);
-				glEnd();
-
-				distSinceLastSleeper = 0.0f;
-				currentU = sleeperU;
-				startSample = sleeperSample;
-				segmentLength = distanceBetween(startSample.pos, endSample.pos);
-				if (segmentLength < 1e-5f)
-					break;
-			}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, packet->geometry->sleeperVertices.data());
+	glNormalPointer(GL_FLOAT, 0, packet->geometry->sleeperNormals.data());
+	glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(packet->geometry->sleeperVertices.size() / 3));
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
 
-			distSinceLastSleeper += segmentLength;
-		}
+//************************************************************************
+//
+// * Pick up geometry the builder has finished, and if the track, the
+//   spline type or the tessellation has changed since, start the next
+//   build. nothing here waits for a build
+//========================================================================
+void TrainView::updateGeometry()
+{
+	if (!m_pTrack)
+		return;
+	if (std::shared_ptr<const TrackGeometry> built = builder.takeFinished()) {
+		geometry = built;
+		if (tw)
+			tw->simulation.setGeometry(built);
 	}
 
-	if (sleeperSamples.empty()) {
-		SplineSample fallback = sampleSpline(0.0f, splineChoice);
-		SplineSample ahead = sampleSpline(0.1f, splineChoice);
-		Pnt3f tangent = ahead.pos - fallback.pos;
-		if (lengthSquared(tangent) < 1e-6f)
-			tangent = Pnt3f(0.0f, 0.0f, 1.0f);
-		tangent.normalize();
-		fallback.tangent = tangent;
-		fallback.param = 0.0f;
-		sleeperSamples.push_back(fallback);
-	}
+	const int splineChoice = currentSplineChoice();
+	const int railProfile = currentRailProfile();
+	if (geometry && geometry->matches(m_pTrack->revision, splineChoice, DIVIDE_LINE, railProfile))
+		return;
+	builder.request(m_pTrack->points, m_pTrack->revision, splineChoice, DIVIDE_LINE, railProfile);
+}
+
+void TrainView::waitForGeometry()
+{
+	updateGeometry();
+	while (builder.busy())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	updateGeometry();
+}
+
+void TrainView::setGeometry(std::shared_ptr<const TrackGeometry> built)
+{
+	// whatever the builder is working on is for the old points
+	builder.discard();
+	geometry = built;
+	if (tw)
+		tw->simulation.setGeometry(built);
+}
+
+//************************************************************************
+//
+// * A build finished - runs on the UI thread (Fl::awake)
+//========================================================================
+void TrainView::geometryReadyCB(void* view)
+{
+	static_cast<TrainView*>(view)->redraw();
 }
 
 void TrainView::drawTrain(bool doingShadows)
 {
-	const size_t count = sleeperSamples.size();
-	if (count == 0)
+	if (!packet->geometry || packet->geometry->sleepers.empty())
 		return;
 
-	const float total = static_cast<float>(count);
-	float u = (m_pTrack) ? m_pTrack->trainU : 0.0f;
-	if (total > 0.0f) {
-		u = std::fmod(u, total);
-		if (u < 0.0f)
-			u += total;
-	} else {
-		u = 0.0f;
-	}
-
-	size_t idx0 = static_cast<size_t>(std::floor(u));
-	if (idx0 >= count)
-		idx0 = count - 1;
-	size_t idx1 = (idx0 + 1) % count;
-	const float interp = (count > 1) ? (u - static_cast<float>(idx0)) : 0.0f;
-	const SplineSample& s0 = sleeperSamples[idx0];
-	const SplineSample& s1 = sleeperSamples[idx1];
-
-	const Pnt3f pos = (count > 1) ? lerp(s0.pos, s1.pos, interp) : s0.pos;
-	Pnt3f up = (count > 1) ? normalizeVector(lerp(s0.orient, s1.orient, interp)) : normalizeVector(s0.orient);
-	Pnt3f forward = (count > 1) ? normalizeVector(lerp(s0.tangent, s1.tangent, interp)) : normalizeVector(s0.tangent);
-
-	if (lengthSquared(up) < 1e-6f)
-		up = Pnt3f(0.0f, 1.0f, 0.0f);
-	if (lengthSquared(forward) < 1e-6f)
-		forward = Pnt3f(0.0f, 0.0f, 1.0f);
-
-	forward.normalize();
-	up.normalize();
-
-	Pnt3f right = forward * up;
-	if (lengthSquared(right) < 1e-6f) {
-		up = Pnt3f(0.0f, 1.0f, 0.0f);
-		right = forward * up;
-		if (lengthSquared(right) < 1e-6f) {
-			up = Pnt3f(1.0f, 0.0f, 0.0f);
-			right = forward * up;
-		}
-	}
-	right.normalize();
-	up = right * forward;
-	up.normalize();
+	// the frame table already has a clean frame for every spot on the track
+	const TrackFrame frame = packet->geometry->trainFrame(packet->trainU);
+	const Pnt3f pos = frame.pos;
+	const Pnt3f up = frame.up();
+	const Pnt3f forward = frame.forward();
+	const Pnt3f right = frame.right();
 
 	const float halfSize = 3.0f;
 	const Pnt3f cubeCenter = pos + up * halfSize; // lift cube so it rides on top of the sleeper
@@ -882,44 +1099,47 @@ void TrainView::drawTrain(bool doingShadows)
 		glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, matShininess);
 	}
 
-	glBegin(GL_QUADS);
+	// the colour and material above are GL state, the flush draws with them
+	ImmediateBatch& imm = ImmediateBatch::instance();
+	imm.begin(GL_QUADS);
 	// bottom face
-	glNormal3f(-up.x, -up.y, -up.z);
-	glVertex3f(c000.x, c000.y, c000.z);
-	glVertex3f(c100.x, c100.y, c100.z);
-	glVertex3f(c101.x, c101.y, c101.z);
-	glVertex3f(c001.x, c001.y, c001.z);
+	imm.normal3f(-up.x, -up.y, -up.z);
+	imm.vertex3f(c000.x, c000.y, c000.z);
+	imm.vertex3f(c100.x, c100.y, c100.z);
+	imm.vertex3f(c101.x, c101.y, c101.z);
+	imm.vertex3f(c001.x, c001.y, c001.z);
 	// top face
-	glNormal3f(up.x, up.y, up.z);
-	glVertex3f(c010.x, c010.y, c010.z);
-	glVertex3f(c011.x, c011.y, c011.z);
-	glVertex3f(c111.x, c111.y, c111.z);
-	glVertex3f(c110.x, c110.y, c110.z);
+	imm.normal3f(up.x, up.y, up.z);
+	imm.vertex3f(c010.x, c010.y, c010.z);
+	imm.vertex3f(c011.x, c011.y, c011.z);
+	imm.vertex3f(c111.x, c111.y, c111.z);
+	imm.vertex3f(c110.x, c110.y, c110.z);
 	// left face
-	glNormal3f(-right.x, -right.y, -right.z);
-	glVertex3f(c000.x, c000.y, c000.z);
-	glVertex3f(c001.x, c001.y, c001.z);
-	glVertex3f(c011.x, c011.y, c011.z);
-	glVertex3f(c010.x, c010.y, c010.z);
+	imm.normal3f(-right.x, -right.y, -right.z);
+	imm.vertex3f(c000.x, c000.y, c000.z);
+	imm.vertex3f(c001.x, c001.y, c001.z);
+	imm.vertex3f(c011.x, c011.y, c011.z);
+	imm.vertex3f(c010.x, c010.y, c010.z);
 	// right face
-	glNormal3f(right.x, right.y, right.z);
-	glVertex3f(c100.x, c100.y, c100.z);
-	glVertex3f(c110.x, c110.y, c110.z);
-	glVertex3f(c111.x, c111.y, c111.z);
-	glVertex3f(c101.x, c101.y, c101.z);
+	imm.normal3f(right.x, right.y, right.z);
+	imm.vertex3f(c100.x, c100.y, c100.z);
+	imm.vertex3f(c110.x, c110.y, c110.z);
+	imm.vertex3f(c111.x, c111.y, c111.z);
+	imm.vertex3f(c101.x, c101.y, c101.z);
 	// back face
-	glNormal3f(-forward.x, -forward.y, -forward.z);
-	glVertex3f(c000.x, c000.y, c000.z);
-	glVertex3f(c010.x, c010.y, c010.z);
-	glVertex3f(c110.x, c110.y, c110.z);
-	glVertex3f(c100.x, c100.y, c100.z);
+	imm.normal3f(-forward.x, -forward.y, -forward.z);
+	imm.vertex3f(c000.x, c000.y, c000.z);
+	imm.vertex3f(c010.x, c010.y, c010.z);
+	imm.vertex3f(c110.x, c110.y, c110.z);
+	imm.vertex3f(c100.x, c100.y, c100.z);
 	// front face
-	glNormal3f(forward.x, forward.y, forward.z);
-	glVertex3f(c001.x, c001.y, c001.z);
-	glVertex3f(c101.x, c101.y, c101.z);
-	glVertex3f(c111.x, c111.y, c111.z);
-	glVertex3f(c011.x, c011.y, c011.z);
-	glEnd();
+	imm.normal3f(forward.x, forward.y, forward.z);
+	imm.vertex3f(c001.x, c001.y, c001.z);
+	imm.vertex3f(c101.x, c101.y, c101.z);
+	imm.vertex3f(c111.x, c111.y, c111.z);
+	imm.vertex3f(c011.x, c011.y, c011.z);
+	imm.end();
+	imm.flush();
 }
 
 int TrainView::currentSplineChoice() const
@@ -927,78 +1147,11 @@ int TrainView::currentSplineChoice() const
 	return (tw && tw->splineBrowser) ? tw->splineBrowser->value() : 1;
 }
 
-TrainView::SplineSample TrainView::sampleSpline(float u, int splineChoice) const
+int TrainView::currentRailProfile() const
 {
-	SplineSample sample{};
-	if (!m_pTrack || m_pTrack->points.empty())
-		return sample;
-	sample.tangent = Pnt3f(0.0f, 0.0f, 0.0f);
-
-	const size_t pointCount = m_pTrack->points.size();
-	const float totalSpan = static_cast<float>(pointCount);
-	float wrappedU = std::fmod(u, totalSpan);
-	if (wrappedU < 0.0f)
-		wrappedU += totalSpan;
-	int baseSeg = static_cast<int>(std::floor(wrappedU));
-	float localT = wrappedU - static_cast<float>(baseSeg);
-	baseSeg = static_cast<int>(wrapIndex(baseSeg, pointCount));
-
-	const ControlPoint& cp0 = m_pTrack->points[wrapIndex(baseSeg, pointCount)];
-	const ControlPoint& cp1 = m_pTrack->points[wrapIndex(baseSeg + 1, pointCount)];
-
-	sample.pos = lerp(cp0.pos, cp1.pos, localT);
-	sample.orient = normalizeVector(lerp(cp0.orient, cp1.orient, localT));
-	sample.tangent = cp1.pos - cp0.pos;
-
-	if (pointCount >= 4) {
-		const ControlPoint& cm1 = m_pTrack->points[wrapIndex(baseSeg - 1, pointCount)];
-		const ControlPoint& cp2 = m_pTrack->points[wrapIndex(baseSeg + 2, pointCount)];
-
-		if (splineChoice == 2) {
-			float weights[4];
-			float deriv[4];
-			cardinalWeights(localT, weights);
-			cardinalDerivatives(localT, deriv);
-			Pnt3f geomPos[4] = { cm1.pos, cp0.pos, cp1.pos, cp2.pos };
-			Pnt3f geomOrient[4] = { cm1.orient, cp0.orient, cp1.orient, cp2.orient };
-			sample.pos = Pnt3f(0.0f, 0.0f, 0.0f);
-			sample.orient = Pnt3f(0.0f, 0.0f, 0.0f);
-			sample.tangent = Pnt3f(0.0f, 0.0f, 0.0f);
-			for (int i = 0; i < 4; ++i) {
-				sample.pos = sample.pos + geomPos[i] * weights[i];
-				sample.orient = sample.orient + geomOrient[i] * weights[i];
-				sample.tangent = sample.tangent + geomPos[i] * deriv[i];
-			}
-			sample.orient = normalizeVector(sample.orient);
-		}
-		else if (splineChoice == 3) {
-			float weights[4];
-			float deriv[4];
-			bsplineWeights(localT, weights);
-			bsplineDerivatives(localT, deriv);
-			Pnt3f geomPos[4] = { cm1.pos, cp0.pos, cp1.pos, cp2.pos };
-			Pnt3f geomOrient[4] = { cm1.orient, cp0.orient, cp1.orient, cp2.orient };
-			sample.pos = Pnt3f(0.0f, 0.0f, 0.0f);
-			sample.orient = Pnt3f(0.0f, 0.0f, 0.0f);
-			sample.tangent = Pnt3f(0.0f, 0.0f, 0.0f);
-			for (int i = 0; i < 4; ++i) {
-				sample.pos = sample.pos + geomPos[i] * weights[i];
-				sample.orient = sample.orient + geomOrient[i] * weights[i];
-				sample.tangent = sample.tangent + geomPos[i] * deriv[i];
-			}
-			sample.orient = normalizeVector(sample.orient);
-		}
-	}
-
-	sample.param = static_cast<float>(baseSeg) + localT;
-
-	return sample;
+	return (tw && tw->railBrowser) ? tw->railBrowser->value() : RAIL_IBEAM;
 }
 
-size_t TrainView::sleeperCount() const
-{
-	return sleeperSamples.size();
-}
 
 
 
@@ -1007,7 +1160,8 @@ size_t TrainView::sleeperCount() const
 //
 // * this tries to see which control point is under the mouse
 //	  (for when the mouse is clicked)
-//		it uses OpenGL picking - which is always a trick
+//		it shoots a ray through the mouse rather than using GL_SELECT,
+//		which draws everything again with the driver's slow path
 //########################################################################
 // TODO: 
 //		if you want to pick things other than control points, or you
@@ -1018,65 +1172,95 @@ void TrainView::
 doPick()
 //========================================================================
 {
-	// since we'll need to do some GL stuff so we make this window as 
-	// active window
-	make_current();		
-
-	// where is the mouse?
-	int mx = Fl::event_x(); 
-	int my = Fl::event_y();
-
-	// get the viewport - most reliable way to turn mouse coords into GL coords
-	int viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
-
-	// Set up the pick matrix on the stack - remember, FlTk is
-	// upside down!
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity ();
-	gluPickMatrix((double)mx, (double)(viewport[3]-my), 
-						5, 5, viewport);
-
-	// now set up the projection
-	setProjection();
-
-	// now draw the objects - but really only see what we hit
-	GLuint buf[100];
-	glSelectBuffer(100,buf);
-	glRenderMode(GL_SELECT);
-	glInitNames();
-	glPushName(0);
-
-	// draw the cubes, loading the names as we go
-	for(size_t i=0; i<m_pTrack->points.size(); ++i) {
-		glLoadName((GLuint) (i+1));
-		m_pTrack->points[i].draw();
-	}
-
-	// go back to drawing mode, and see how picking did
-	int hits = glRenderMode(GL_RENDER);
-	if (hits) {
-		// warning; this just grabs the first object hit - if there
-		// are multiple objects, you really want to pick the closest
-		// one - see the OpenGL manual 
-		// remember: we load names that are one more than the index
-		selectedCube = buf[3]-1;
-	} else // nothing hit, nothing selected
+	// the line under the mouse, out of the camera of the last frame -
+	// only the main view picks
+	float x, y;
+	if (!mouseInView(x, y)) {
 		selectedCube = -1;
+		return;
+	}
+	glm::vec3 from, to;
+	cameraRay(camera, x, y, from, to);
+
+	// the box and the point on top of it fit in a ball of this radius
+	// around the point. a first pass over just the positions finds the
+	// points whose ball the line goes near - a straight run over the x,
+	// y and z arrays that vectorizes - and only those get the exact test
+	const float REACH = 6.64f;
+	const glm::vec3 along = to - from;
+	const float reach2 = REACH * REACH * glm::dot(along, along);
+
+	// take it into each point's own frame (the one CoreRenderer turns its
+	// instance into) and take the nearest point whose box it goes through
+	selectedCube = -1;
+	float nearest = 2.0f;
+	size_t before = 0;
+	unsigned char candidate[ControlPointList::MAX_CHUNK];
+	for (size_t c = 0; c < m_pTrack->points.chunkCount(); ++c) {
+		const ControlPointList::Span span = m_pTrack->points.chunk(c);
+		for (size_t k = 0; k < span.count; ++k) {
+			const float px = span.x[k] - from.x;
+			const float py = span.y[k] - from.y;
+			const float pz = span.z[k] - from.z;
+			const float cx = py * along.z - pz * along.y;
+			const float cy = pz * along.x - px * along.z;
+			const float cz = px * along.y - py * along.x;
+			candidate[k] = (cx * cx + cy * cy + cz * cz <= reach2) ? 1 : 0;
+		}
+
+		for (size_t k = 0; k < span.count; ++k) {
+			if (!candidate[k])
+				continue;
+			const glm::quat rotation =
+				glm::angleAxis(-std::atan2(span.oz[k], span.ox[k]), glm::vec3(0, 1, 0))
+				* glm::angleAxis(-std::acos(std::max(-1.0f, std::min(1.0f, span.oy[k]))), glm::vec3(0, 0, 1));
+			const glm::quat toLocal = glm::conjugate(rotation);
+			const glm::vec3 center(span.x[k], span.y[k], span.z[k]);
+			const glm::vec3 start = toLocal * (from - center);
+			const glm::vec3 direction = toLocal * along;
+
+			// the cube and the point on top of it
+			const glm::vec3 boxMin(-2.0f, -2.0f, -2.0f);
+			const glm::vec3 boxMax(2.0f, 6.0f, 2.0f);
+			float enter = 0.0f, leave = 1.0f;
+			for (int axis = 0; axis < 3 && enter <= leave; ++axis) {
+				if (std::fabs(direction[axis]) < 1e-12f) {
+					if (start[axis] < boxMin[axis] || start[axis] > boxMax[axis])
+						leave = -1.0f;
+					continue;
+				}
+				float t0 = (boxMin[axis] - start[axis]) / direction[axis];
+				float t1 = (boxMax[axis] - start[axis]) / direction[axis];
+				if (t0 > t1)
+					std::swap(t0, t1);
+				enter = std::max(enter, t0);
+				leave = std::min(leave, t1);
+			}
+			if (enter <= leave && enter < nearest) {
+				nearest = enter;
+				selectedCube = static_cast<int>(before + k);
+			}
+		}
+		before += span.count;
+	}
 
 	printf("Selected Cube %d\n",selectedCube);
 }
 
 void TrainView::setCastle() {
-	this->normalCastle = new Shader("./shaders/simple.vert", nullptr, nullptr, nullptr, "./shaders/simple.frag");
-	this->common_matrices = new UBO();
-
+	if (!this->normalCastle) {
+		this->normalCastle = new Shader("./shaders/simple.vert", nullptr, nullptr, nullptr, "./shaders/simple.frag");
+	}
+	makeCommonMatrices();
+	if (!this->texture) {
+		this->texture = new Texture2D("./images/church.png");
+	}
 
-	this->common_matrices->size = 2 * sizeof(glm::mat4);
-	glGenBuffers(1, &this->common_matrices->ubo);
-	glBindBuffer(GL_UNIFORM_BUFFER, this->common_matrices->ubo);
-	glBufferData(GL_UNIFORM_BUFFER, this->common_matrices->size, NULL, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// draw() calls this every frame - only upload the quad if plane holds
+	// something else
+	if (planeShape == PLANE_CASTLE)
+		return;
+	planeShape = PLANE_CASTLE;
 
 	GLfloat vertices[] = {
 		-0.5f ,0.0f , -0.5f,
@@ -1100,54 +1284,53 @@ void TrainView::setCastle() {
 		0, 1, 2,
 		0, 2, 3, };
 
-	this->plane = new VAO();
-	*this->plane = {};
+	makePlane();
 	this->plane->element_amount = sizeof(element) / sizeof(GLuint);
-	glGenVertexArrays(1, &this->plane->vao);
-	glGenBuffers(3, this->plane->vbo);
-	glGenBuffers(1, &this->plane->ebo);
 
 	glBindVertexArray(this->plane->vao);
 
 	// Position attribute
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[0], sizeof(vertices), vertices, GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(0);
 
 	// Normal attribute
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normal), normal, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[1], sizeof(normal), normal, GL_STATIC_DRAW);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(1);
 
 	// Texture Coordinate attribute
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[2]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(texture_coordinate), texture_coordinate, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[2], sizeof(texture_coordinate), texture_coordinate, GL_STATIC_DRAW);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(2);
 
+	// no colors - the water or the colored castle may have left some on
+	glDisableVertexAttribArray(3);
+
 	// Element attribute
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(element), element, GL_STATIC_DRAW);
+	bufferData(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo, sizeof(element), element, GL_STATIC_DRAW);
 
 	// Unbind VAO
 	glBindVertexArray(0);
-	
-	this->texture = new Texture2D("./images/church.png");
 }
 
 void TrainView::setColoredCastle()  {
-	this->coloredCastle = new Shader("./shaders/colored.vert", nullptr, nullptr, nullptr, "./shaders/colored.frag");
-	this->common_matrices = new UBO();
+	if (!this->coloredCastle) {
+		this->coloredCastle = new Shader("./shaders/colored.vert", nullptr, nullptr, nullptr, "./shaders/colored.frag");
+	}
+	makeCommonMatrices();
+	if (!this->texture) {
+		this->texture = new Texture2D("./images/church.png");
+	}
 
-	this->common_matrices->size = 2 * sizeof(glm::mat4);
-	glGenBuffers(1, &this->common_matrices->ubo);
-	glBindBuffer(GL_UNIFORM_BUFFER, this->common_matrices->ubo);
-	glBufferData(GL_UNIFORM_BUFFER, this->common_matrices->size, NULL, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (planeShape == PLANE_COLORED_CASTLE)
+		return;
+	planeShape = PLANE_COLORED_CASTLE;
 
-	
 	GLfloat vertices[] = {
 		-0.5f, 0.0f, -0.5f,  
 		-0.5f, 0.0f,  0.5f,   
@@ -1174,57 +1357,73 @@ void TrainView::setColoredCastle()  {
 	};
 
 
-	this->plane = new VAO();
-	*this->plane = {};
+	makePlane();
 	this->plane->element_amount = sizeof(element) / sizeof(GLuint);
-	glGenVertexArrays(1, &this->plane->vao);
-	glGenBuffers(4, this->plane->vbo);
-	glGenBuffers(1, &this->plane->ebo);
 
 	glBindVertexArray(this->plane->vao);
 
 	// Position attribute
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[0], sizeof(vertices), vertices, GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(0);
 
 	// Normal attribute
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normal), normal, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[1], sizeof(normal), normal, GL_STATIC_DRAW);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(1);
 
 	// Texture Coordinate attribute
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[2]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(texture_coordinate), texture_coordinate, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[2], sizeof(texture_coordinate), texture_coordinate, GL_STATIC_DRAW);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(2);
 
 	// color attribute
 		
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[3]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(color), color, GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[3], sizeof(color), color, GL_STATIC_DRAW);
 	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 	glEnableVertexAttribArray(3);
 
 	// Element attribute
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(element), element, GL_STATIC_DRAW);
+	bufferData(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo, sizeof(element), element, GL_STATIC_DRAW);
 
 	// Unbind VAO
 	glBindVertexArray(0);
-	this->texture = new Texture2D("./images/church.png");
 }
 
-void TrainView::setWave(float time) {
-	const int gridResolution = 100;
-	const float waterSize = 5.5f;
-
-	if (!this->wave) {
-		this->wave = new Shader("./shaders/height.vert", nullptr, nullptr, nullptr, "./shaders/height.frag");
+//************************************************************************
+//
+// * The VAO and buffers every shape of plane goes into - made once
+//========================================================================
+void TrainView::makePlane()
+{
+	if (!this->plane) {
+		this->plane = new VAO();
+		*this->plane = {};
+	}
+	if (this->plane->vao == 0) {
+		genVertexArrays(1, &this->plane->vao, "TrainView plane");
+	}
+	for (int i = 0; i < 4; ++i) {
+		if (this->plane->vbo[i] == 0) {
+			genBuffers(1, &this->plane->vbo[i], "TrainView plane");
+		}
 	}
+	if (this->plane->ebo == 0) {
+		genBuffers(1, &this->plane->ebo, "TrainView plane");
+	}
+}
 
+//************************************************************************
+//
+// * The view and projection UBO all of the plane shaders share - made once
+//========================================================================
+void TrainView::makeCommonMatrices()
+{
 	if (!this->common_matrices) {
 		this->common_matrices = new UBO();
 		this->common_matrices->ubo = 0;
@@ -1233,78 +1432,115 @@ void TrainView::setWave(float time) {
 
 	this->common_matrices->size = 2 * sizeof(glm::mat4);
 	if (this->common_matrices->ubo == 0) {
-		glGenBuffers(1, &this->common_matrices->ubo);
+		genBuffers(1, &this->common_matrices->ubo, "TrainView matrices");
+		glBindBuffer(GL_UNIFORM_BUFFER, this->common_matrices->ubo);
+		bufferData(GL_UNIFORM_BUFFER, this->common_matrices->ubo, this->common_matrices->size, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	}
-	glBindBuffer(GL_UNIFORM_BUFFER, this->common_matrices->ubo);
-	glBufferData(GL_UNIFORM_BUFFER, this->common_matrices->size, nullptr, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
 
-	if (!this->plane) {
-		this->plane = new VAO();
-		*this->plane = {};
+void TrainView::setWave(float time) {
+	const int gridResolution = 100;
+	const float waterSize = 5.5f;
+
+	if (!this->wave) {
+		this->wave = new Shader("./shaders/height.vert", nullptr, nullptr, nullptr, "./shaders/height.frag");
 	}
 
-	if (this->plane->vao == 0) {
-		glGenVertexArrays(1, &this->plane->vao);
+	makeCommonMatrices();
+
+	uploadWaterGrid(gridResolution, waterSize, glm::vec3(0.0f, 0.6f, 1.0f));
+
+	if (!this->heightMap) {
+		this->heightMap = new Texture2D("./images/wave.png");
 	}
-	for (int i = 0; i < 4; ++i) {
-		if (this->plane->vbo[i] == 0) {
-			glGenBuffers(1, &this->plane->vbo[i]);
+
+	this->wave->Use();
+
+	if (this->heightMap) {
+		this->heightMap->bind(1);
+		GLint samplerLoc = glGetUniformLocation(this->wave->Program, "u_heightmap");
+		if (samplerLoc != -1) {
+			glUniform1i(samplerLoc, 1);
+		}
+		GLint texelLoc = glGetUniformLocation(this->wave->Program, "u_texel");
+		if (texelLoc != -1) {
+			glUniform2f(texelLoc,
+				1.0f / static_cast<float>(heightMap->size.x),
+				1.0f / static_cast<float>(heightMap->size.y));
 		}
-	}
-	if (this->plane->ebo == 0) {
-		glGenBuffers(1, &this->plane->ebo);
 	}
 
-	vertices.clear();
-	normals.clear();
-	texcoords.clear();
-	colors.clear();
-	elements.clear();
+	GLint timeLoc = glGetUniformLocation(this->wave->Program, "u_time");
+	if (timeLoc != -1) {
+		glUniform1f(timeLoc, time);
+	}
 
-	const size_t vertexCount = static_cast<size_t>((gridResolution + 1) * (gridResolution + 1));
-	vertices.reserve(vertexCount * 3);
-	normals.reserve(vertexCount * 3);
-	texcoords.reserve(vertexCount * 2);
-	colors.reserve(vertexCount * 3);
-	elements.reserve(static_cast<size_t>(gridResolution) * gridResolution * 6);
+	glUseProgram(0);
+}
 
-	const float step = waterSize / static_cast<float>(gridResolution);
-	const float halfSize = waterSize * 0.5f;
+//************************************************************************
+//
+// * The flat grid the water shaders move around, into plane - only when
+//   plane holds something else. it is put together in the frame arena
+//========================================================================
+void TrainView::uploadWaterGrid(int resolution, float size, const glm::vec3& color)
+{
+	const unsigned int elementCount = static_cast<unsigned int>(resolution) * static_cast<unsigned int>(resolution) * 6u;
 
-	for (int j = 0; j <= gridResolution; ++j) {
-		for (int i = 0; i <= gridResolution; ++i) {
-			float x = i * step - halfSize;
-			float z = j * step - halfSize;
+	makePlane();
 
-			vertices.push_back(x);
+	if (planeShape == PLANE_WATER && this->plane->element_amount == elementCount
+		&& waterGrid.resolution == resolution && waterGrid.size == size && waterGrid.color == color)
+		return;
+	planeShape = PLANE_WATER;
+	waterGrid.resolution = resolution;
+	waterGrid.size = size;
+	waterGrid.color = color;
+
+	const size_t vertexCount = static_cast<size_t>(resolution + 1) * static_cast<size_t>(resolution + 1);
+	ArenaVector<GLfloat> vertices{ ArenaAllocator<GLfloat>(frameArena) };
+	ArenaVector<GLfloat> normals{ ArenaAllocator<GLfloat>(frameArena) };
+	ArenaVector<GLfloat> texcoords{ ArenaAllocator<GLfloat>(frameArena) };
+	ArenaVector<GLfloat> colors{ ArenaAllocator<GLfloat>(frameArena) };
+	ArenaVector<GLuint> elements{ ArenaAllocator<GLuint>(frameArena) };
+	vertices.reserve(vertexCount * 3u);
+	normals.reserve(vertexCount * 3u);
+	texcoords.reserve(vertexCount * 2u);
+	colors.reserve(vertexCount * 3u);
+	elements.reserve(elementCount);
+
+	const float step = size / static_cast<float>(resolution);
+	const float halfSize = size * 0.5f;
+	for (int j = 0; j <= resolution; ++j) {
+		for (int i = 0; i <= resolution; ++i) {
+			vertices.push_back(static_cast<float>(i) * step - halfSize);
 			vertices.push_back(0.0f);
-			vertices.push_back(z);
+			vertices.push_back(static_cast<float>(j) * step - halfSize);
 
 			normals.push_back(0.0f);
 			normals.push_back(1.0f);
 			normals.push_back(0.0f);
 
-			texcoords.push_back(static_cast<float>(i) / static_cast<float>(gridResolution));
-			texcoords.push_back(static_cast<float>(j) / static_cast<float>(gridResolution));
+			texcoords.push_back(static_cast<float>(i) / static_cast<float>(resolution));
+			texcoords.push_back(static_cast<float>(j) / static_cast<float>(resolution));
 
-			colors.push_back(0.0f);
-			colors.push_back(0.6f);
-			colors.push_back(1.0f);
+			colors.push_back(color.r);
+			colors.push_back(color.g);
+			colors.push_back(color.b);
 		}
 	}
 
-	for (int j = 0; j < gridResolution; ++j) {
-		for (int i = 0; i < gridResolution; ++i) {
-			GLuint topLeft = static_cast<GLuint>(j * (gridResolution + 1) + i);
+	for (int j = 0; j < resolution; ++j) {
+		for (int i = 0; i < resolution; ++i) {
+			GLuint topLeft = static_cast<GLuint>(j * (resolution + 1) + i);
 			GLuint topRight = topLeft + 1;
-			GLuint bottomLeft = static_cast<GLuint>((j + 1) * (gridResolution + 1) + i);
+			GLuint bottomLeft = static_cast<GLuint>((j + 1) * (resolution + 1) + i);
 			GLuint bottomRight = bottomLeft + 1;
 
 			elements.push_back(topLeft);
 			elements.push_back(bottomLeft);
 			elements.push_back(topRight);
-
 			elements.push_back(topRight);
 			elements.push_back(bottomLeft);
 			elements.push_back(bottomRight);
@@ -1314,34 +1550,36 @@ void TrainView::setWave(float time) {
 	glBindVertexArray(this->plane->vao);
 
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[0], vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 3), nullptr);
 	glEnableVertexAttribArray(0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(GLfloat), normals.data(), GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[1], normals.size() * sizeof(GLfloat), normals.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 3), nullptr);
 	glEnableVertexAttribArray(1);
 
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[2]);
-	glBufferData(GL_ARRAY_BUFFER, texcoords.size() * sizeof(GLfloat), texcoords.data(), GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[2], texcoords.size() * sizeof(GLfloat), texcoords.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 2), nullptr);
 	glEnableVertexAttribArray(2);
 
 	glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[3]);
-	glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
+	bufferData(GL_ARRAY_BUFFER, this->plane->vbo[3], colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 3), nullptr);
 	glEnableVertexAttribArray(3);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
+	bufferData(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
 
-	this->plane->element_amount = static_cast<unsigned int>(elements.size());
+	this->plane->element_amount = elementCount;
 
 	glBindVertexArray(0);
+}
 
-	if (!this->heightMap) {
-		this->heightMap = new Texture2D("./images/wave.png");
+void TrainView::updateWater(float time, int, float) {
+	if (!this->wave) {
+		return;
 	}
 
 	this->wave->Use();
@@ -1368,33 +1606,40 @@ void TrainView::setWave(float time) {
 	glUseProgram(0);
 }
 
-void TrainView::updateWater(float time, int, float) {
-	if (!this->wave) {
-		return;
+void TrainView::setOcean(float time) {
+	// the ocean is drawn with the height map shader on setWave's plane
+	// (which only uploads the grid if another mode has replaced it)
+	setWave(time);
+
+	if (!this->ocean) {
+		this->ocean = new OceanFFT();
 	}
 
-	this->wave->Use();
+	const int n = this->ocean->resolution();
+	if (!this->oceanMap || this->oceanMap->size.x != n) {
+		delete this->oceanMap;
+		delete this->oceanPixels;
+		this->oceanMap = new Texture2D(n, n, GL_RGBA32F, Texture2D::TEXTURE_HEIGHT);
+		this->oceanPixels = new PixelBuffer(static_cast<GLsizeiptr>(n) * n * 4 * sizeof(float));
 
-	if (this->heightMap) {
-		this->heightMap->bind(1);
-		GLint samplerLoc = glGetUniformLocation(this->wave->Program, "u_heightmap");
-		if (samplerLoc != -1) {
-			glUniform1i(samplerLoc, 1);
-		}
-		GLint texelLoc = glGetUniformLocation(this->wave->Program, "u_texel");
-		if (texelLoc != -1) {
-			glUniform2f(texelLoc,
-				1.0f / static_cast<float>(heightMap->size.x),
-				1.0f / static_cast<float>(heightMap->size.y));
-		}
+		// fill it once so there is something to look at before the train runs
+		updateOcean(time);
 	}
+}
 
-	GLint timeLoc = glGetUniformLocation(this->wave->Program, "u_time");
-	if (timeLoc != -1) {
-		glUniform1f(timeLoc, time);
+void TrainView::updateOcean(float time) {
+	if (!this->ocean || !this->oceanMap || !this->oceanPixels || !this->oceanPixels->valid()) {
+		return;
 	}
 
-	glUseProgram(0);
+	// the transform and the unpacking both run on the thread pool, and the
+	// texels go straight into mapped memory - the GPU only does the copy
+	this->ocean->update(time);
+	float* texels = static_cast<float*>(this->oceanPixels->map());
+	this->ocean->writeTexels(texels);
+
+	const int n = this->ocean->resolution();
+	this->oceanPixels->upload(this->oceanMap->getId(), n, n, GL_RGBA, GL_FLOAT);
 }
 
 void TrainView::useShader(int choice) {
@@ -1413,16 +1658,28 @@ void TrainView::useShader(int choice) {
 		break;
 	case 3:
 		if (!wave) {
-			setWave(getTime() - startTime);
+			setWave(packet->time - startTime);
 		}
 		currentShader = wave;
 		break;
 	case 4:
 		if (!sineWaveShader) {
-			setWaveSine(getTime());
+			setWaveSine(packet->time);
 		}
 		currentShader = sineWaveShader;
 		break;
+	case 5:
+		if (!gerstnerShader) {
+			setWaveGerstner(packet->time);
+		}
+		currentShader = gerstnerShader;
+		break;
+	case 6:
+		if (!ocean) {
+			setOcean(packet->time);
+		}
+		currentShader = wave;
+		break;
 	default:
 		currentShader = nullptr;
 		break;
@@ -1455,10 +1712,8 @@ void TrainView::useShader(int choice) {
 	setMatrixUniform("u_model", model_matrix);
 	setMatrixUniform("model", model_matrix);
 
-	glm::mat4 view_matrix(1.0f);
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glm::mat4 projection_matrix(1.0f);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
+	const glm::mat4& view_matrix = currentView->camera.view;
+	const glm::mat4& projection_matrix = currentView->camera.projection;
 
 	setMatrixUniform("u_view", view_matrix);
 	setMatrixUniform("view_matrix", view_matrix);
@@ -1473,8 +1728,12 @@ void TrainView::useShader(int choice) {
 	}
 
 	if (currentShader == wave) {
-		if (heightMap) {
-			heightMap->bind(1);
+		// the FFT ocean goes through the same shader, it just swaps in its
+		// own height map and stops the map from scrolling
+		const bool fftOcean = (choice == 6 && oceanMap);
+		Texture2D* map = fftOcean ? oceanMap : heightMap;
+		if (map) {
+			map->bind(1);
 			GLint samplerLoc = glGetUniformLocation(currentShader->Program, "u_heightmap");
 			if (samplerLoc != -1) {
 				glUniform1i(samplerLoc, 1);
@@ -1482,13 +1741,19 @@ void TrainView::useShader(int choice) {
 			GLint texelLoc = glGetUniformLocation(currentShader->Program, "u_texel");
 			if (texelLoc != -1) {
 				glUniform2f(texelLoc,
-					1.0f / static_cast<float>(heightMap->size.x),
-					1.0f / static_cast<float>(heightMap->size.y));
+					1.0f / static_cast<float>(map->size.x),
+					1.0f / static_cast<float>(map->size.y));
 			}
 		}
 		const float waveAmplitude = 3.0f;
-		const float waveSpeed = 0.25f;
-		const float heightMix = 0.8f;
+		const float waveSpeed = fftOcean ? 0.0f : 0.25f;
+		const float heightMix = fftOcean ? 1.0f : 0.8f;
+		// same meters -> model units factor the heights end up with
+		const float choppy = fftOcean ? 2.0f * ocean->getSettings().heightScale * waveAmplitude : 0.0f;
+		GLint choppyLoc = glGetUniformLocation(currentShader->Program, "u_choppy");
+		if (choppyLoc != -1) {
+			glUniform1f(choppyLoc, choppy);
+		}
 		GLint ampLoc = glGetUniformLocation(currentShader->Program, "u_amp");
 		if (ampLoc != -1) {
 			glUniform1f(ampLoc, waveAmplitude);
@@ -1501,6 +1766,11 @@ void TrainView::useShader(int choice) {
 		if (heightMultLoc != -1) {
 			glUniform1f(heightMultLoc, heightMix);
 		}
+	} else if (currentShader == gerstnerShader) {
+		uploadWaves();
+		if (this->wave_params && this->wave_params->ubo != 0) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, 1, this->wave_params->ubo, 0, this->wave_params->size);
+		}
 	} else if (currentShader == sineWaveShader) {
 		const float tempAmplitude = 2.0f;
 		GLint ampLoc = glGetUniformLocation(currentShader->Program, "u_amplitude");
@@ -1534,151 +1804,116 @@ void TrainView::useShader(int choice) {
 void TrainView::setWaveSine(float time) {
 	const int gridResolution = 100;
 	const float waterSize = 4.5f;
-	const unsigned int expectedElements = static_cast<unsigned int>(gridResolution) * static_cast<unsigned int>(gridResolution) * 6u;
 
 	if (!sineWaveShader) {
 		sineWaveShader = new Shader("./shaders/sine.vert", nullptr, nullptr, nullptr, "./shaders/sine.frag");
 	}
 
-	if (!this->common_matrices) {
-		this->common_matrices = new UBO();
-		this->common_matrices->ubo = 0;
-		this->common_matrices->size = 0;
-	}
+	makeCommonMatrices();
 
-	this->common_matrices->size = 2 * sizeof(glm::mat4);
-	if (this->common_matrices->ubo == 0) {
-		glGenBuffers(1, &this->common_matrices->ubo);
-	}
-	glBindBuffer(GL_UNIFORM_BUFFER, this->common_matrices->ubo);
-	glBufferData(GL_UNIFORM_BUFFER, this->common_matrices->size, nullptr, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	uploadWaterGrid(gridResolution, waterSize, glm::vec3(0.1f, 0.45f, 0.75f));
 
-	if (!this->plane) {
-		this->plane = new VAO();
-		*this->plane = {};
+	sineWaveShader->Use();
+	GLint timeLoc = glGetUniformLocation(sineWaveShader->Program, "u_time");
+	if (timeLoc != -1) {
+		glUniform1f(timeLoc, time);
 	}
+	glUseProgram(0);
+}
 
-	if (this->plane->vao == 0) {
-		glGenVertexArrays(1, &this->plane->vao);
-	}
-	for (int i = 0; i < 4; ++i) {
-		if (this->plane->vbo[i] == 0) {
-			glGenBuffers(1, &this->plane->vbo[i]);
-		}
-	}
-	if (this->plane->ebo == 0) {
-		glGenBuffers(1, &this->plane->ebo);
+void TrainView::updateSine(float time) {
+	if (!sineWaveShader) {
+		return;
 	}
 
-	bool needUpload = (this->plane->element_amount != expectedElements);
-
-	if (needUpload) {
-		vertices.clear();
-		normals.clear();
-		texcoords.clear();
-		colors.clear();
-		elements.clear();
-
-		const float step = waterSize / static_cast<float>(gridResolution);
-		const float halfSize = waterSize * 0.5f;
-		const size_t vertexCount = static_cast<size_t>(gridResolution + 1) * static_cast<size_t>(gridResolution + 1);
-
-		vertices.reserve(vertexCount * 3u);
-		normals.reserve(vertexCount * 3u);
-		texcoords.reserve(vertexCount * 2u);
-		colors.reserve(vertexCount * 3u);
-		elements.reserve(expectedElements);
-
-		for (int j = 0; j <= gridResolution; ++j) {
-			for (int i = 0; i <= gridResolution; ++i) {
-				float x = static_cast<float>(i) * step - halfSize;
-				float z = static_cast<float>(j) * step - halfSize;
-
-				vertices.push_back(x);
-				vertices.push_back(0.0f);
-				vertices.push_back(z);
-
-				normals.push_back(0.0f);
-				normals.push_back(1.0f);
-				normals.push_back(0.0f);
+	sineWaveShader->Use();
+	GLint timeLoc = glGetUniformLocation(sineWaveShader->Program, "u_time");
+	if (timeLoc != -1) {
+		glUniform1f(timeLoc, time);
+	}
+	glUseProgram(0);
+}
 
-				texcoords.push_back(static_cast<float>(i) / static_cast<float>(gridResolution));
-				texcoords.push_back(static_cast<float>(j) / static_cast<float>(gridResolution));
+void TrainView::updateSin(float time) {
+	updateSine(time);
+}
 
-				colors.push_back(0.1f);
-				colors.push_back(0.45f);
-				colors.push_back(0.75f);
-			}
-		}
+void TrainView::setWaves(const std::vector<Wave>& newWaves) {
+	waves.assign(newWaves.begin(), newWaves.begin() + std::min(newWaves.size(), MAX_WAVES));
+	wavesDirty = true;
+}
 
-		for (int j = 0; j < gridResolution; ++j) {
-			for (int i = 0; i < gridResolution; ++i) {
-				GLuint topLeft = static_cast<GLuint>(j * (gridResolution + 1) + i);
-				GLuint topRight = topLeft + 1;
-				GLuint bottomLeft = static_cast<GLuint>((j + 1) * (gridResolution + 1) + i);
-				GLuint bottomRight = bottomLeft + 1;
-
-				elements.push_back(topLeft);
-				elements.push_back(bottomLeft);
-				elements.push_back(topRight);
-				elements.push_back(topRight);
-				elements.push_back(bottomLeft);
-				elements.push_back(bottomRight);
-			}
-		}
+// The wave set lives in a std140 UBO (binding 1) laid out as
+//   ivec4 count; { vec4(dir.xy, wavelength, amplitude), vec4(speed, steepness, frequency, 0) }[MAX_WAVES]
+// The whole block is written with a single glBufferSubData, and only when the
+// wave set has changed since the last upload.
+void TrainView::uploadWaves() {
+	if (!this->wave_params) {
+		this->wave_params = new UBO();
+		this->wave_params->ubo = 0;
+		this->wave_params->size = static_cast<GLsizeiptr>((1 + 2 * MAX_WAVES) * sizeof(glm::vec4));
+	}
+	if (this->wave_params->ubo == 0) {
+		genBuffers(1, &this->wave_params->ubo, "TrainView waves");
+		glBindBuffer(GL_UNIFORM_BUFFER, this->wave_params->ubo);
+		bufferData(GL_UNIFORM_BUFFER, this->wave_params->ubo, this->wave_params->size, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		wavesDirty = true;
+	}
 
-		glBindVertexArray(this->plane->vao);
+	if (!wavesDirty)
+		return;
 
-		glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[0]);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 3), nullptr);
-		glEnableVertexAttribArray(0);
+	ArenaVector<glm::vec4> block(1 + 2 * MAX_WAVES, glm::vec4(0.0f), ArenaAllocator<glm::vec4>(frameArena));
+	const size_t count = std::min(waves.size(), MAX_WAVES);
+	GLint countBits[4] = { static_cast<GLint>(count), 0, 0, 0 };
+	std::memcpy(&block[0], countBits, sizeof(countBits));
+	for (size_t i = 0; i < count; ++i) {
+		Wave& w = waves[i];
+		const float wavelength = (w.wavelength > 1e-4f) ? w.wavelength : 1e-4f;
+		w.frequency = 2.0f * static_cast<float>(M_PI) / wavelength;
+		block[1 + 2 * i] = glm::vec4(w.direction.x, w.direction.y, wavelength, w.amplitude);
+		block[2 + 2 * i] = glm::vec4(w.speed, w.steepness, w.frequency, 0.0f);
+	}
 
-		glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[1]);
-		glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(GLfloat), normals.data(), GL_STATIC_DRAW);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 3), nullptr);
-		glEnableVertexAttribArray(1);
+	glBindBuffer(GL_UNIFORM_BUFFER, this->wave_params->ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, this->wave_params->size, block.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	wavesDirty = false;
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[2]);
-		glBufferData(GL_ARRAY_BUFFER, texcoords.size() * sizeof(GLfloat), texcoords.data(), GL_STATIC_DRAW);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 2), nullptr);
-		glEnableVertexAttribArray(2);
+void TrainView::setWaveGerstner(float time) {
+	const int gridResolution = 128;
+	const float waterSize = 4.5f;
 
-		glBindBuffer(GL_ARRAY_BUFFER, this->plane->vbo[3]);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(GLfloat) * 3), nullptr);
-		glEnableVertexAttribArray(3);
+	if (!gerstnerShader) {
+		gerstnerShader = new Shader("./shaders/gerstner.vert", nullptr, nullptr, nullptr, "./shaders/sine.frag");
+	}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->plane->ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
+	makeCommonMatrices();
 
-		glBindVertexArray(0);
-	}
+	uploadWaves();
 
-	this->plane->element_amount = expectedElements;
+	// the grid is flat - all of the motion happens in gerstner.vert
+	uploadWaterGrid(gridResolution, waterSize, glm::vec3(0.1f, 0.45f, 0.75f));
 
-	sineWaveShader->Use();
-	GLint timeLoc = glGetUniformLocation(sineWaveShader->Program, "u_time");
+	gerstnerShader->Use();
+	GLint timeLoc = glGetUniformLocation(gerstnerShader->Program, "u_time");
 	if (timeLoc != -1) {
 		glUniform1f(timeLoc, time);
 	}
 	glUseProgram(0);
 }
 
-void TrainView::updateSine(float time) {
-	if (!sineWaveShader) {
+void TrainView::updateGerstner(float time) {
+	if (!gerstnerShader) {
 		return;
 	}
 
-	sineWaveShader->Use();
-	GLint timeLoc = glGetUniformLocation(sineWaveShader->Program, "u_time");
+	gerstnerShader->Use();
+	GLint timeLoc = glGetUniformLocation(gerstnerShader->Program, "u_time");
 	if (timeLoc != -1) {
 		glUniform1f(timeLoc, time);
 	}
 	glUseProgram(0);
 }
-
-void TrainView::updateSin(float time) {
-	updateSine(time);
-}
\ No newline at end of file
@@ -27,6 +27,7 @@
 
 #include <FL/fl.h>
 #include <FL/Fl_Box.h>
+#include <FL/fl_ask.h>
 
 // for using the real time clock
 #include <time.h>
@@ -34,7 +35,6 @@
 #include <algorithm>
 #include <cmath>
 #include <numeric>
-#include <chrono>
 
 #include "TrainWindow.H"
 #include "TrainView.H"
@@ -67,6 +67,7 @@ TrainWindow(const int x, const int y)
 
 		runButton = new Fl_Button(605,pty,60,20,"Run");
 		togglify(runButton);
+		runButton->callback((Fl_Callback*)simulationCB,this);
 
 		Fl_Button* fb = new Fl_Button(700,pty,25,20,"@>>");
 		fb->callback((Fl_Callback*)forwCB,this);
@@ -75,6 +76,7 @@ TrainWindow(const int x, const int y)
 		
 		arcLength = new Fl_Button(730,pty,65,20,"ArcLength");
 		togglify(arcLength,1);
+		arcLength->callback((Fl_Callback*)simulationCB,this);
   
 		pty+=25;
 		speed = new Fl_Value_Slider(655,pty,140,20,"speed");
@@ -82,6 +84,7 @@ TrainWindow(const int x, const int y)
 		speed->value(2);
 		speed->align(FL_ALIGN_LEFT);
 		speed->type(FL_HORIZONTAL);
+		speed->callback((Fl_Callback*)simulationCB,this);
 
 		pty += 30;
 
@@ -117,6 +120,15 @@ TrainWindow(const int x, const int y)
 		splineBrowser->add("Cubic B-Spline");
 		splineBrowser->select(2);
 
+		// what the rails look like
+		railBrowser = new Fl_Browser(730,pty,65,75,"Rails");
+		railBrowser->type(2);		// select
+		railBrowser->callback((Fl_Callback*)damageCB,this);
+		railBrowser->add("I-Beam");
+		railBrowser->add("Tube");
+		railBrowser->add("Spine");
+		railBrowser->select(1);
+
 		pty += 110;
 
 		lightBrowser = new Fl_Browser(605, pty, 120, 75, "Light Type");
@@ -127,6 +139,12 @@ TrainWindow(const int x, const int y)
 		lightBrowser->add("Spot light");
 		lightBrowser->select(1);
 
+		cabFov = new Fl_Value_Slider(745, pty, 40, 75, "Cab FOV");
+		cabFov->range(100, 30);
+		cabFov->step(1);
+		cabFov->value(60);
+		cabFov->callback((Fl_Callback*)damageCB, this);
+
 		pty += 110;
 
 		shaderBrowser = new Fl_Browser(605, pty, 120, 75, "Image Type");
@@ -136,6 +154,8 @@ TrainWindow(const int x, const int y)
 		shaderBrowser->add("Colored Castle");
 		shaderBrowser->add("Height Map Wave");
 		shaderBrowser->add("Sine Wave");
+		shaderBrowser->add("Gerstner Wave");
+		shaderBrowser->add("FFT Ocean");
 		shaderBrowser->select(1);
 		
 		pty += 110;
@@ -166,8 +186,24 @@ TrainWindow(const int x, const int y)
 		Fl_Button* rzp = new Fl_Button(700,pty,30,20,"R-Z");
 		rzp->callback((Fl_Callback*)rmzCB,this);
 
+		// all three cameras at once
+		splitViews = new Fl_Button(735,pty,60,20,"Split");
+		togglify(splitViews);
+
 		pty+=30;
 
+		// only visible while a track loads in the background
+		loadProgress = new Fl_Progress(605,pty,125,20);
+		loadProgress->minimum(0);
+		loadProgress->maximum(1);
+		loadProgress->selection_color((Fl_Color)3);
+		loadProgress->hide();
+		cancelLoadButton = new Fl_Button(735,pty,60,20,"Cancel");
+		cancelLoadButton->callback((Fl_Callback*)cancelLoadCB,this);
+		cancelLoadButton->hide();
+
+		pty+=25;
+
 		// TODO: add widgets for all of your fancier features here
 #ifdef EXAMPLE_SOLUTION
 		makeExampleWidgets(this,pty);
@@ -181,6 +217,8 @@ TrainWindow(const int x, const int y)
 	}
 	end();	// done adding to this widget
 
+	updateSimulation();
+
 	// set up callback on idle
 	Fl::add_idle((void (*)(void*))runButtonCB,this);
 }
@@ -214,205 +252,115 @@ damageMe()
 
 //************************************************************************
 //
-// * This will get called (approximately) 30 times per second
-//   if the run button is pressed
+// * One step - carried out straight away with no simulation thread,
+//   otherwise queued for its next tick
 //========================================================================
 void TrainWindow::
 advanceTrain(float dir)
 //========================================================================
 {
-	const size_t segmentCount = m_Track.points.size();
-	if (segmentCount < 2)
-		return;
-
-	const float direction = (dir >= 0.0f) ? 1.0f : -1.0f;
-	const float absDir = std::fabs(dir);
-	const float magnitude = (absDir > 0.0f) ? absDir : 0.0f;
-	const float sliderSpeed = static_cast<float>(speed->value());
-	const float stepScale = 0.3f;
-	const float expectedUpdatesPerSecond = 30.0f;
-	const float baseArcSpeed = stepScale * expectedUpdatesPerSecond;
-	const float segmentDurationSeconds = 2.0f;
-	const float minSliderValue = 0.05f;
-
-	// compute elapsed time (seconds) between calls
-	const auto now = std::chrono::steady_clock::now();
-	if (lastAdvanceTick == std::chrono::steady_clock::time_point{})
-		lastAdvanceTick = now;
-	float dt = std::chrono::duration_cast<std::chrono::duration<float>>(now - lastAdvanceTick).count();
-	if (!runButton || !runButton->value()) {
-		// manual stepping – treat each call as a single frame
-		dt = 1.0f / expectedUpdatesPerSecond;
-	} else {
-		if (dt <= 0.0f)
-			dt = 1.0f / expectedUpdatesPerSecond;
-		else if (dt > 0.25f)
-			dt = 0.25f; // clamp so pauses don't fling the train
-	}
-	lastAdvanceTick = now;
-	dt *= magnitude;
-
-	if (!trainView)
-		return;
-
-	const size_t sleeperTotal = trainView->sleeperCount();
-	const float maxU = (sleeperTotal > 0)
-		? static_cast<float>(sleeperTotal)
-		: static_cast<float>(segmentCount);
-	if (maxU <= 0.0f)
-		return;
-
-	refreshSegmentMetrics();
-	if (segmentSampleCounts.empty())
-		return;
-
-	float delta = 0.0f;
-	if (arcLength && arcLength->value()) {
-		int segmentIdx = segmentIndexFromTrainU();
-		if (segmentIdx < 0)
-			segmentIdx = 0;
-		else if (segmentIdx >= static_cast<int>(segmentSampleCounts.size()))
-			segmentIdx = static_cast<int>(segmentSampleCounts.size()) - 1;
-		float samplesInSegment = segmentSampleCounts[segmentIdx];
-		float lengthInSegment = segmentArcLengths[segmentIdx];
-		if (samplesInSegment <= 1e-4f)
-			samplesInSegment = (averageSamplesPerSegment > 1e-4f) ? averageSamplesPerSegment : 1.0f;
-		if (lengthInSegment <= 1e-4f)
-			lengthInSegment = (averageArcLengthPerSegment > 1e-4f) ? averageArcLengthPerSegment : 1.0f;
-		float denomSamples = (samplesInSegment > 1.0f) ? samplesInSegment : 1.0f;
-		float denomAverageSamples = (averageSamplesPerSegment > 1.0f) ? averageSamplesPerSegment : 1.0f;
-		float lengthPerSample = lengthInSegment / denomSamples;
-		float averageLengthPerSample = averageArcLengthPerSegment / denomAverageSamples;
-		if (lengthPerSample <= 1e-4f)
-			lengthPerSample = averageLengthPerSample;
-		if (averageLengthPerSample <= 1e-4f)
-			averageLengthPerSample = 1.0f;
-		float effectiveSlider = (sliderSpeed > minSliderValue) ? sliderSpeed : minSliderValue;
-		float physicalSpeed = effectiveSlider * baseArcSpeed * averageLengthPerSample;
-		float safeLengthPerSample = (lengthPerSample > 1e-4f) ? lengthPerSample : 1e-4f;
-		float unitsPerSecond = physicalSpeed / safeLengthPerSample;
-		delta = direction * unitsPerSecond * dt;
-	} else {
-		// fixed time per control-point segment
-		int segmentIdx = segmentIndexFromTrainU();
-		if (segmentIdx < 0)
-			segmentIdx = 0;
-		else if (segmentIdx >= static_cast<int>(segmentSampleCounts.size()))
-			segmentIdx = static_cast<int>(segmentSampleCounts.size()) - 1;
-		float samplesInSegment = segmentSampleCounts[segmentIdx];
-		if (samplesInSegment <= 1e-4f)
-			samplesInSegment = averageSamplesPerSegment;
-		float duration = segmentDurationSeconds;
-		float speedFactor = (sliderSpeed > minSliderValue) ? sliderSpeed : minSliderValue;
-		duration /= speedFactor; // faster slider -> shorter duration
-		if (duration <= 1e-4f)
-			duration = segmentDurationSeconds;
-		float unitsPerSecond = samplesInSegment / duration;
-		delta = direction * unitsPerSecond * dt;
-	}
-
-	m_Track.trainU += delta;
-	while (m_Track.trainU >= maxU)
-		m_Track.trainU -= maxU;
-	while (m_Track.trainU < 0.0f)
-		m_Track.trainU += maxU;
+	updateSimulation();
+	const float step = (fixedStep > 0.0f) ? fixedStep : 1.0f / 30.0f;
+	simulation.advance(dir * step);
+	m_Track.trainU = simulation.trainU();
 
 	if (trainView)
 		trainView->damage(1);
 }
 
-void TrainWindow::refreshSegmentMetrics()
+//************************************************************************
+//
+// *
+//========================================================================
+void TrainWindow::
+updateSimulation()
+//========================================================================
 {
-	const size_t segmentCount = m_Track.points.size();
-	segmentSampleCounts.assign(segmentCount, 0.0f);
-	segmentArcLengths.assign(segmentCount, 0.0f);
-	averageSamplesPerSegment = 1.0f;
-	averageArcLengthPerSegment = 1.0f;
-	cachedSleeperSampleCount = (trainView) ? trainView->sleeperCount() : 0;
-	cachedSplineChoice = (trainView) ? trainView->currentSplineChoice() : -1;
-
-	if (segmentCount == 0 || !trainView)
-		return;
+	TrainSettings settings;
+	settings.running = runButton->value() != 0;
+	settings.speed = static_cast<float>(speed->value());
+	settings.arcLength = arcLength->value() != 0;
+	simulation.setSettings(settings);
+}
 
-	const auto& samples = trainView->sleeperSamples;
-	const float sleeperSpacing = 8.0f;
-
-	if (!samples.empty()) {
-		const size_t sampleCount = samples.size();
-		for (size_t i = 0; i < sampleCount; ++i) {
-			const auto& s0 = samples[i];
-			const auto& s1 = samples[(i + 1) % sampleCount];
-			int segIdx = static_cast<int>(std::floor(s0.param));
-			segIdx %= static_cast<int>(segmentCount);
-			if (segIdx < 0)
-				segIdx += static_cast<int>(segmentCount);
-			float stepLength = trainView->distanceBetween(s0.pos, s1.pos);
-			segmentArcLengths[segIdx] += stepLength;
-			segmentSampleCounts[segIdx] += 1.0f;
-		}
-	} else {
-		for (size_t seg = 0; seg < segmentCount; ++seg) {
-			const ControlPoint& cp0 = m_Track.points[seg];
-			const ControlPoint& cp1 = m_Track.points[(seg + 1) % segmentCount];
-			float length = trainView->distanceBetween(cp0.pos, cp1.pos);
-			segmentArcLengths[seg] = length;
-			segmentSampleCounts[seg] = 1.0f;
-		}
-	}
+//************************************************************************
+//
+// * Start a background load - the current track stays on screen
+//========================================================================
+void TrainWindow::
+loadTrack(const char* filename)
+//========================================================================
+{
+	trackLoader.start(filename, trainView->currentSplineChoice(), trainView->DIVIDE_LINE,
+					  trainView->currentRailProfile(), trackLoadedCB, this);
+
+	loadProgress->value(0);
+	loadProgress->label(trackLoader.stage());
+	loadProgress->show();
+	cancelLoadButton->show();
+	Fl::remove_timeout(loadProgressCB, this);
+	Fl::add_timeout(1.0 / 30.0, loadProgressCB, this);
+}
 
-	float totalSamples = std::accumulate(segmentSampleCounts.begin(), segmentSampleCounts.end(), 0.0f);
-	if (totalSamples > 1e-4f)
-		averageSamplesPerSegment = totalSamples / static_cast<float>(segmentCount);
-	else
-		averageSamplesPerSegment = 1.0f;
-
-	float totalLength = std::accumulate(segmentArcLengths.begin(), segmentArcLengths.end(), 0.0f);
-	if (totalLength > 1e-4f)
-		averageArcLengthPerSegment = totalLength / static_cast<float>(segmentCount);
-	else
-		averageArcLengthPerSegment = sleeperSpacing;
+//************************************************************************
+//
+// *
+//========================================================================
+void TrainWindow::
+cancelLoad()
+//========================================================================
+{
+	trackLoader.cancel();
 }
 
-int TrainWindow::segmentIndexFromTrainU() const
+//************************************************************************
+//
+// * Keep the progress bar moving while the worker runs
+//========================================================================
+void TrainWindow::
+loadProgressCB(void* data)
+//========================================================================
 {
-	const size_t segmentCount = m_Track.points.size();
-	if (segmentCount == 0)
-		return 0;
-	if (!trainView)
-		return 0;
-
-	const auto& samples = trainView->sleeperSamples;
-	if (samples.empty()) {
-		int segIdx = static_cast<int>(std::floor(m_Track.trainU));
-		segIdx %= static_cast<int>(segmentCount);
-		if (segIdx < 0)
-			segIdx += static_cast<int>(segmentCount);
-		return segIdx;
-	}
+	TrainWindow* tw = static_cast<TrainWindow*>(data);
+	if (!tw->trackLoader.busy())
+		return;
+	tw->loadProgress->value(tw->trackLoader.progress());
+	tw->loadProgress->label(tw->trackLoader.stage());
+	Fl::repeat_timeout(1.0 / 30.0, loadProgressCB, data);
+}
 
-	const size_t sampleCount = samples.size();
-	double wrapped = m_Track.trainU;
-	if (sampleCount > 0) {
-		wrapped = std::fmod(wrapped, static_cast<double>(sampleCount));
-		if (wrapped < 0.0)
-			wrapped += static_cast<double>(sampleCount);
+//************************************************************************
+//
+// * Runs on the UI thread (through Fl::awake) when the worker is done:
+//   swap the new points and their geometry in together
+//========================================================================
+void TrainWindow::
+trackLoadedCB(void* data)
+//========================================================================
+{
+	TrainWindow* tw = static_cast<TrainWindow*>(data);
+	Fl::remove_timeout(loadProgressCB, data);
+	tw->loadProgress->hide();
+	tw->cancelLoadButton->hide();
+
+	// the loader only calls this for the load it is on now
+	TrackLoader::Result loaded = tw->trackLoader.takeResult();
+	if (loaded.cancelled || loaded.generation != tw->trackLoader.generation())
+		return;
+	if (!loaded.ok) {
+		fl_alert("%s", loaded.error.c_str());
+		return;
 	}
 
-	const size_t idx0 = static_cast<size_t>(std::floor(wrapped)) % sampleCount;
-	const size_t idx1 = (idx0 + 1) % sampleCount;
-	const double localT = wrapped - std::floor(wrapped);
-
-	float param0 = samples[idx0].param;
-	float param1 = samples[idx1].param;
-	if (idx1 == 0 && param1 < param0)
-		param1 += static_cast<float>(segmentCount);
-	if (param1 < param0)
-		param1 += static_cast<float>(segmentCount);
-	float interpolated = param0 + (param1 - param0) * static_cast<float>(localT);
-
-	int segIdx = static_cast<int>(std::floor(interpolated));
-	segIdx %= static_cast<int>(segmentCount);
-	if (segIdx < 0)
-		segIdx += static_cast<int>(segmentCount);
-	return segIdx;
-}
\ No newline at end of file
+	CTrack& track = tw->m_Track;
+	track.points.swap(loaded.track.points);
+	track.metadata.swap(loaded.track.metadata);
+	track.metadataStride = loaded.track.metadataStride;
+	track.markChanged();
+	tw->simulation.place(0.0f);
+
+	loaded.geometry->revision = track.revision;
+	tw->trainView->setGeometry(loaded.geometry);
+	tw->trainView->selectedCube = -1;
+	tw->damageMe();
+}
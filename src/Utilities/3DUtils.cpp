@@ -30,6 +30,8 @@
 
 #include <math.h>
 
+// glad before GL/gl.h, for the batch
+#include "../RenderUtilities/ImmediateBatch.h"
 #include <windows.h>
 #include <GL/gl.h>
 #include <FL/Fl.h>
@@ -55,47 +57,49 @@ using std::vector;
 void drawCube(float x, float y, float z, float l)
 //===============================================================================
 {
-	glPushMatrix();
-		glTranslated(x,y,z);
-		glScalef(l,l,l);
-		glBegin(GL_QUADS);
-			glNormal3d( 0,0,1);
-			glVertex3d( 0.5, 0.5, 0.5);
-			glVertex3d(-0.5, 0.5, 0.5);
-			glVertex3d(-0.5,-0.5, 0.5);
-			glVertex3d( 0.5,-0.5, 0.5);
-
-			glNormal3d( 0, 0, -1);
-			glVertex3d( 0.5, 0.5, -0.5);
-			glVertex3d( 0.5,-0.5, -0.5);
-			glVertex3d(-0.5,-0.5, -0.5);
-			glVertex3d(-0.5, 0.5, -0.5);
-
-			glNormal3d( 0, 1, 0);
-			glVertex3d( 0.5, 0.5, 0.5);
-			glVertex3d( 0.5, 0.5,-0.5);
-			glVertex3d(-0.5, 0.5,-0.5);
-			glVertex3d(-0.5, 0.5, 0.5);
-
-			glNormal3d( 0,-1,0);
-			glVertex3d( 0.5,-0.5, 0.5);
-			glVertex3d(-0.5,-0.5, 0.5);
-			glVertex3d(-0.5,-0.5,-0.5);
-			glVertex3d( 0.5,-0.5,-0.5);
-
-			glNormal3d( 1,0,0);
-			glVertex3d( 0.5, 0.5, 0.5);
-			glVertex3d( 0.5,-0.5, 0.5);
-			glVertex3d( 0.5,-0.5,-0.5);
-			glVertex3d( 0.5, 0.5,-0.5);
-
-			glNormal3d(-1,0,0);
-			glVertex3d(-0.5, 0.5, 0.5);
-			glVertex3d(-0.5, 0.5,-0.5);
-			glVertex3d(-0.5,-0.5,-0.5);
-			glVertex3d(-0.5,-0.5, 0.5);
-		glEnd();
-	glPopMatrix();
+	ImmediateBatch& imm = ImmediateBatch::instance();
+	imm.pushMatrix();
+		imm.translate(x,y,z);
+		imm.scale(l,l,l);
+		imm.begin(GL_QUADS);
+			imm.normal3d( 0,0,1);
+			imm.vertex3d( 0.5, 0.5, 0.5);
+			imm.vertex3d(-0.5, 0.5, 0.5);
+			imm.vertex3d(-0.5,-0.5, 0.5);
+			imm.vertex3d( 0.5,-0.5, 0.5);
+
+			imm.normal3d( 0, 0, -1);
+			imm.vertex3d( 0.5, 0.5, -0.5);
+			imm.vertex3d( 0.5,-0.5, -0.5);
+			imm.vertex3d(-0.5,-0.5, -0.5);
+			imm.vertex3d(-0.5, 0.5, -0.5);
+
+			imm.normal3d( 0, 1, 0);
+			imm.vertex3d( 0.5, 0.5, 0.5);
+			imm.vertex3d( 0.5, 0.5,-0.5);
+			imm.vertex3d(-0.5, 0.5,-0.5);
+			imm.vertex3d(-0.5, 0.5, 0.5);
+
+			imm.normal3d( 0,-1,0);
+			imm.vertex3d( 0.5,-0.5, 0.5);
+			imm.vertex3d(-0.5,-0.5, 0.5);
+			imm.vertex3d(-0.5,-0.5,-0.5);
+			imm.vertex3d( 0.5,-0.5,-0.5);
+
+			imm.normal3d( 1,0,0);
+			imm.vertex3d( 0.5, 0.5, 0.5);
+			imm.vertex3d( 0.5,-0.5, 0.5);
+			imm.vertex3d( 0.5,-0.5,-0.5);
+			imm.vertex3d( 0.5, 0.5,-0.5);
+
+			imm.normal3d(-1,0,0);
+			imm.vertex3d(-0.5, 0.5, 0.5);
+			imm.vertex3d(-0.5, 0.5,-0.5);
+			imm.vertex3d(-0.5,-0.5,-0.5);
+			imm.vertex3d(-0.5,-0.5, 0.5);
+		imm.end();
+	imm.popMatrix();
+	imm.flush();
 }
 
 //*************************************************************************
@@ -122,19 +126,21 @@ void drawFloor(float size, int nSquares)
 	v[2] = 0;
 	xd = (maxX - minX) / ((float) nSquares);
 	yd = (maxY - minY) / ((float) nSquares);
-	glBegin(GL_QUADS);
+	ImmediateBatch& imm = ImmediateBatch::instance();
+	imm.begin(GL_QUADS);
 	for(x=0,xp=minX; x<nSquares; x++,xp+=xd) {
 		for(y=0,yp=minY,i=x; y<nSquares; y++,i++,yp+=yd) {
-			glColor4fv(i%2==1 ? floorColor1:floorColor2);
-			glNormal3f(0, 1, 0); 
-			glVertex3d(xp,      0, yp);
-			glVertex3d(xp,      0, yp + yd);
-			glVertex3d(xp + xd, 0, yp + yd);
-			glVertex3d(xp + xd, 0, yp);
+			imm.color3fv(i%2==1 ? floorColor1:floorColor2);
+			imm.normal3f(0, 1, 0); 
+			imm.vertex3d(xp,      0, yp);
+			imm.vertex3d(xp,      0, yp + yd);
+			imm.vertex3d(xp + xd, 0, yp + yd);
+			imm.vertex3d(xp + xd, 0, yp);
 
 		} // end of for j
 	}// end of for i
-	glEnd();
+	imm.end();
+	imm.flush();
 }
 
 //*************************************************************************
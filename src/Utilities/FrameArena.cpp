@@ -0,0 +1,108 @@
+/************************************************************************
+     File:        FrameArena.cpp
+
+     Comment:     A bump allocator. See FrameArena.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "FrameArena.H"
+
+#include <cstdint>
+
+//****************************************************************************
+//
+// *
+//============================================================================
+FrameArena::
+FrameArena(size_t blockSize)
+	: current(0), offset(0), blockSize(blockSize)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+FrameArena::
+~FrameArena()
+//============================================================================
+{
+	for (const Block& block : blocks)
+		delete[] block.data;
+}
+
+//****************************************************************************
+//
+// * The rest of the current block, or the next one that fits
+//============================================================================
+void* FrameArena::
+allocate(size_t bytes, size_t align)
+//============================================================================
+{
+	for (;;) {
+		if (current < blocks.size()) {
+			const Block& block = blocks[current];
+			const uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+			const size_t start = static_cast<size_t>(((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+			if (start <= block.size && bytes <= block.size - start) {
+				offset = start + bytes;
+				counters.used += bytes;
+				if (counters.used > counters.peak)
+					counters.peak = counters.used;
+				return block.data + start;
+			}
+			if (current + 1 < blocks.size()) {
+				++current;
+				offset = 0;
+				continue;
+			}
+		}
+		addBlock(bytes + align);
+	}
+}
+
+//****************************************************************************
+//
+// * If the frame spilled into more than one block, they are swapped for a
+//   single one that holds all of it
+//============================================================================
+void FrameArena::
+reset()
+//============================================================================
+{
+	if (blocks.size() > 1) {
+		size_t total = 0;
+		for (const Block& block : blocks) {
+			total += block.size;
+			delete[] block.data;
+		}
+		blocks.clear();
+		counters.capacity = 0;
+		addBlock(total);
+	}
+	current = 0;
+	offset = 0;
+	counters.used = 0;
+	++counters.resets;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void FrameArena::
+addBlock(size_t atLeast)
+//============================================================================
+{
+	Block block;
+	block.size = atLeast > blockSize ? atLeast : blockSize;
+	block.data = new char[block.size];
+	blocks.push_back(block);
+	current = blocks.size() - 1;
+	offset = 0;
+	counters.capacity += block.size;
+	++counters.heapAllocations;
+}
@@ -0,0 +1,145 @@
+/************************************************************************
+     File:        MappedFile.cpp
+
+     Comment:     Read-only view of a whole file through the virtual
+						memory system. See MappedFile.H
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "MappedFile.H"
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+MappedFile::
+MappedFile()
+	: view(0), length(0), opened(false)
+#ifdef _WIN32
+	, file(INVALID_HANDLE_VALUE), mapping(0)
+#else
+	, fd(-1)
+#endif
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * Destructor
+//============================================================================
+MappedFile::
+~MappedFile()
+//============================================================================
+{
+	close();
+}
+
+//****************************************************************************
+//
+// * Map the whole file read-only
+//============================================================================
+bool MappedFile::
+open(const char* filename)
+//============================================================================
+{
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+					   OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(fileSize.QuadPart);
+
+	// CreateFileMapping refuses empty files
+	if (length > 0) {
+		mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (!mapping) {
+			close();
+			return false;
+		}
+		view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!view) {
+			close();
+			return false;
+		}
+	}
+#else
+	fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(st.st_size);
+
+	if (length > 0) {
+		void* p = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close();
+			return false;
+		}
+		madvise(p, length, MADV_SEQUENTIAL);
+		view = static_cast<const char*>(p);
+	}
+#endif
+
+	opened = true;
+	return true;
+}
+
+//****************************************************************************
+//
+// * Unmap and release the file
+//============================================================================
+void MappedFile::
+close()
+//============================================================================
+{
+#ifdef _WIN32
+	if (view)
+		UnmapViewOfFile(view);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = 0;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (view)
+		munmap(const_cast<char*>(view), length);
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+#endif
+	view = 0;
+	length = 0;
+	opened = false;
+}
@@ -64,7 +64,6 @@ class Pnt3f {
 		friend Pnt3f operator * (const float s, const Pnt3f& p );
 
 	public:
-		float length = sqrt(x * x + y * y + z * z);
 		// for simplicity, we just make this public so everything can access
 		// it. real software engineers would make the internal data private.
 		float x;			/* isn't this obvious */
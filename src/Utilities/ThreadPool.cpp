@@ -0,0 +1,285 @@
+/************************************************************************
+     File:        ThreadPool.cpp
+
+     Comment:     A small fixed-size work-stealing pool of worker threads.
+						See ThreadPool.H for how to use it.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "ThreadPool.H"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	// which pool and queue the current thread works for - the owner
+	// pushes to and pops from its own queue
+	thread_local const ThreadPool*	currentPool = nullptr;
+	thread_local size_t				currentQueue = 0;
+}
+
+// what the range jobs of one parallelFor share. a range job might only get
+// to run after parallelFor has returned (it finds nothing left to do), so
+// this can't live on the caller's stack
+struct ThreadPool::ForLoop {
+	const std::function<void(size_t, size_t)>*	body;
+	size_t										grain;
+	std::atomic<size_t>							remaining;	// indices not run yet
+	std::mutex									lock;
+	std::condition_variable						finished;
+};
+
+//****************************************************************************
+//
+// * Start the worker threads
+//============================================================================
+ThreadPool::
+ThreadPool(unsigned workers)
+	: queued(0), stealFrom(0), stopping(false)
+//============================================================================
+{
+	if (workers == 0) {
+		unsigned hw = std::thread::hardware_concurrency();
+		workers = (hw > 1) ? hw - 1 : 1;
+	}
+	for (unsigned i = 0; i <= workers; ++i)
+		queues.emplace_back(new Queue);
+	threads.reserve(workers);
+	for (unsigned i = 0; i < workers; ++i)
+		threads.emplace_back(&ThreadPool::workerLoop, this, static_cast<size_t>(i) + 1);
+}
+
+//****************************************************************************
+//
+// * Finish whatever is queued, then join the workers
+//============================================================================
+ThreadPool::
+~ThreadPool()
+//============================================================================
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& t : threads)
+		t.join();
+}
+
+//****************************************************************************
+//
+// * The pool everyone shares - created the first time someone asks
+//============================================================================
+ThreadPool& ThreadPool::
+instance()
+//============================================================================
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+unsigned ThreadPool::
+concurrency() const
+//============================================================================
+{
+	return static_cast<unsigned>(threads.size()) + 1;
+}
+
+//****************************************************************************
+//
+// * Queue a job for the workers
+//============================================================================
+void ThreadPool::
+submit(std::function<void()> job)
+//============================================================================
+{
+	push(Job{ std::move(job), nullptr });
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+size_t ThreadPool::
+ownQueue() const
+//============================================================================
+{
+	return (currentPool == this) ? currentQueue : 0;
+}
+
+//****************************************************************************
+//
+// * Put a job at the back of our own queue and wake a sleeping worker
+//============================================================================
+void ThreadPool::
+push(Job job)
+//============================================================================
+{
+	Queue& queue = *queues[ownQueue()];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.jobs.push_back(std::move(job));
+	}
+	queued.fetch_add(1);
+	{
+		// taking the lock makes sure a worker that just found nothing to
+		// do is either still checking queued or already waiting
+		std::lock_guard<std::mutex> guard(sleepLock);
+	}
+	wake.notify_one();
+}
+
+//****************************************************************************
+//
+// * Find a job: the newest one in our own queue, or else the oldest one
+//   in somebody else's
+//============================================================================
+bool ThreadPool::
+pop(Job& job, const void* group)
+//============================================================================
+{
+	if (queued.load() == 0)
+		return false;
+
+	const size_t own = ownQueue();
+	const size_t count = queues.size();
+	const size_t start = stealFrom.fetch_add(1);
+	for (size_t n = 0; n < count; ++n) {
+		// own queue first, then everyone else starting somewhere different
+		// every time, so the thieves don't all pile onto the same victim
+		const size_t index = (n == 0) ? own : (start + n) % count;
+		if (n > 0 && index == own)
+			continue;
+
+		Queue& queue = *queues[index];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.jobs.empty())
+			continue;
+
+		if (index == own) {
+			for (auto it = queue.jobs.rbegin(); it != queue.jobs.rend(); ++it) {
+				if (group && it->group != group)
+					continue;
+				job = std::move(*it);
+				queue.jobs.erase(std::next(it).base());
+				queued.fetch_sub(1);
+				return true;
+			}
+		} else {
+			for (auto it = queue.jobs.begin(); it != queue.jobs.end(); ++it) {
+				if (group && it->group != group)
+					continue;
+				job = std::move(*it);
+				queue.jobs.erase(it);
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//****************************************************************************
+//
+// * Each worker runs jobs until there are none anywhere, then sleeps
+//============================================================================
+void ThreadPool::
+workerLoop(size_t index)
+//============================================================================
+{
+	currentPool = this;
+	currentQueue = index;
+
+	for (;;) {
+		Job job;
+		if (pop(job, nullptr)) {
+			job.run();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(sleepLock);
+		wake.wait(guard, [this] { return stopping || queued.load() != 0; });
+		if (stopping && queued.load() == 0)
+			return;		// stopping, and nothing left to do
+	}
+}
+
+//****************************************************************************
+//
+// * Run the chunks of [begin, end)
+//   keep cutting the range in half, leaving the back half in our queue for
+//   anyone to steal, until only one chunk is left - then run it
+//============================================================================
+void ThreadPool::
+runRange(const std::shared_ptr<ForLoop>& loop, size_t begin, size_t end)
+//============================================================================
+{
+	const size_t grain = loop->grain;
+	for (;;) {
+		const size_t chunks = (end - begin + grain - 1) / grain;
+		if (chunks <= 1)
+			break;
+		const size_t mid = begin + (chunks / 2) * grain;
+		std::shared_ptr<ForLoop> shared = loop;
+		push(Job{ [this, shared, mid, end]() { runRange(shared, mid, end); }, loop.get() });
+		end = mid;
+	}
+
+	(*loop->body)(begin, end);
+	if (loop->remaining.fetch_sub(end - begin) == end - begin) {
+		std::lock_guard<std::mutex> guard(loop->lock);
+		loop->finished.notify_all();
+	}
+}
+
+//****************************************************************************
+//
+// * Split [begin, end) into chunks and run them on the pool
+//   the caller works through the range too, and while it waits for the
+//   pieces that were stolen it only picks up pieces of this same loop -
+//   so the UI thread never ends up running somebody's long job
+//============================================================================
+void ThreadPool::
+parallelFor(size_t begin, size_t end, size_t grain,
+			const std::function<void(size_t, size_t)>& body)
+//============================================================================
+{
+	if (end <= begin)
+		return;
+
+	const size_t count = end - begin;
+	if (grain == 0)
+		grain = std::max<size_t>(1, count / (static_cast<size_t>(concurrency()) * 4));
+
+	if (count <= grain || threads.empty()) {
+		for (size_t b = begin; b < end; b += grain)
+			body(b, std::min(end, b + grain));
+		return;
+	}
+
+	std::shared_ptr<ForLoop> loop = std::make_shared<ForLoop>();
+	loop->body = &body;
+	loop->grain = grain;
+	loop->remaining = count;
+
+	runRange(loop, begin, end);
+
+	while (loop->remaining.load() != 0) {
+		Job job;
+		if (pop(job, loop.get())) {
+			job.run();
+			continue;
+		}
+		// everything left has been stolen - wait for it, but look again
+		// now and then in case a thief split some of it back out
+		std::unique_lock<std::mutex> guard(loop->lock);
+		loop->finished.wait_for(guard, std::chrono::microseconds(200),
+			[&loop] { return loop->remaining.load() == 0; });
+	}
+}
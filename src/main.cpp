@@ -23,8 +23,14 @@
 *************************************************************************/
 
 #include "stdio.h"
+#include <cstdlib>
+#include <cstring>
 #include "TrainWindow.H"
 #include "TrainView.H"
+#include "Benchmark.H"
+#ifdef HEADLESS_RENDERING
+#	include "HeadlessRender.H"
+#endif
 #include "RenderUtilities/BufferObject.h";
 #include "RenderUtilities/Shader.h";
 #include "RenderUtilities/Texture.h"
@@ -37,12 +43,62 @@
 #include <Fl/Fl.h>
 #pragma warning(pop)
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
 	printf("CS559 Train Assignment\n");
 
+	// lets worker threads (the track loader) wake the UI up with Fl::awake
+	Fl::lock();
+
 	TrainWindow tw;
+	// --core draws with the core-profile renderer instead of the fixed
+	// function pipeline
+	// --export <directory> <frames> draws frames into PNG files and quits,
+	// without a window (only with the HEADLESS build option)
+	// --exact-splines samples the track with sampleSpline at every step
+	// instead of forward differencing each segment (to compare them)
+	// --bench <scene.json> runs a scripted benchmark and quits (see
+	// Benchmark.H)
+	// --render-thread draws on a thread of its own, so the UI never waits
+	// for a frame (see RenderThread.H)
+	const char* exportDirectory = nullptr;
+	const char* benchScene = nullptr;
+	int exportFrames = 0;
+	bool renderThread = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--core") == 0)
+			tw.trainView->backend = TrainView::BACKEND_CORE;
+		else if (strcmp(argv[i], "--export") == 0 && i + 2 < argc) {
+			exportDirectory = argv[++i];
+			exportFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--exact-splines") == 0)
+			TrackGeometry::sampling = SAMPLE_EXACT;
+		else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+			benchScene = argv[++i];
+		else if (strcmp(argv[i], "--render-thread") == 0)
+			renderThread = true;
+	}
+	if (benchScene)
+		return runBenchmark(tw, benchScene);
+	if (exportDirectory) {
+#ifdef HEADLESS_RENDERING
+		return renderHeadless(tw, exportDirectory, exportFrames);
+#else
+		fprintf(stderr, "--export needs a build with the HEADLESS option\n");
+		return 1;
+#endif
+	}
+	// the train runs on its own thread from here on
+	tw.simulation.start();
 	tw.show();
+	if (renderThread) {
+		// the first frame is drawn here, which makes the context
+		while (!tw.trainView->shown())
+			Fl::wait();
+		Fl::flush();
+		tw.trainView->startRenderThread();
+	}
 
 	Fl::run();
 }
\ No newline at end of file